@@ -1,23 +1,80 @@
 #include "AlumaX2.h"
+#include "ImageCopy.h"
 
 #include <mutexinterface.h>
 #include <basicstringinterface.h>
 #include <sberrorx.h>
 #include <x2guiinterface.h>
 
-#include <stdexcept>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
 
 constexpr const char* DEVICE_DRIVER_INFO_STRING = "DL Aluma";
 
 constexpr const char* KEY_ALUMAX2_ROOT = "AlumaX2";
 constexpr const char* KEY_ALUMAX2_AUTO_FAN_MODE = "AUTO_FAN_MODE";
 constexpr const char* KEY_ALUMAX2_USE_OVERSCAN = "USE_OVERSCAN";
+constexpr const char* KEY_ALUMAX2_LARGE_PAGES = "LARGE_PAGES";
+constexpr const char* KEY_ALUMAX2_SOFTWARE_BIN_AVERAGE = "SOFTWARE_BIN_AVERAGE";
+constexpr const char* KEY_ALUMAX2_OVERSCAN_CORRECTION = "OVERSCAN_CORRECTION";
+constexpr const char* KEY_ALUMAX2_APPLY_CALIBRATION = "APPLY_CALIBRATION";
+constexpr const char* KEY_ALUMAX2_RECORD_CALIBRATION = "RECORD_CALIBRATION";
+constexpr const char* KEY_ALUMAX2_CALIBRATION_BUDGET = "CALIBRATION_BUDGET";
+constexpr const char* KEY_ALUMAX2_CALIBRATION_DIRECTORY = "CALIBRATION_DIRECTORY";
+constexpr const char* KEY_ALUMAX2_LEARN_DEFECTS = "LEARN_DEFECTS";
+constexpr const char* KEY_ALUMAX2_CORRECT_DEFECTS = "CORRECT_DEFECTS";
+constexpr const char* KEY_ALUMAX2_FRAME_STATISTICS = "FRAME_STATISTICS";
+constexpr const char* KEY_ALUMAX2_EARLY_FILTER_MOVE = "EARLY_FILTER_MOVE";
+constexpr const char* KEY_ALUMAX2_CAMERA_SERIAL_NUMBER = "CAMERA_SERIAL_NUMBER";
+constexpr const char* KEY_ALUMAX2_CAMERA_ENDPOINT = "CAMERA_ENDPOINT";
+constexpr const char* KEY_ALUMAX2_CONNECTION_MODE = "CONNECTION_MODE";
+constexpr const char* KEY_ALUMAX2_NETWORK_ADDRESS = "NETWORK_ADDRESS";
+constexpr const char* KEY_ALUMAX2_NETWORK_PORT = "NETWORK_PORT";
+constexpr const char* KEY_ALUMAX2_DOWNLOAD_TIMEOUT = "DOWNLOAD_TIMEOUT";
+constexpr const char* KEY_ALUMAX2_DOWNLOAD_RETRIES = "DOWNLOAD_RETRIES";
+
+//Values of the connection mode setting, in the order of the radio buttons
+constexpr int CONNECTION_MODE_USB = 0;
+constexpr int CONNECTION_MODE_NETWORK = 1;
+
+//Pixel value counted as saturated in the frame statistics
+constexpr unsigned short SATURATION_LEVEL = 65535;
+
+//Scratch buffers for driver side processing
+constexpr size_t FRAME_SCRATCH_BUFFERS = 2;
+
+//Longest CCStartExposure waits for an early filter move, and how often it checks the wheel meanwhile
+constexpr auto FILTER_MOVE_TIMEOUT = std::chrono::seconds(30);
+constexpr int FILTER_MOVE_POLL_MS = 50;
+
+
+std::mutex AlumaX2::s_instancesMutex;
+std::map<int, AlumaX2*> AlumaX2::s_instances;
+std::mutex AlumaX2::s_discoveryMutex;
 
 
 AlumaX2* AlumaX2::GetInstance(const int& nISIndex, TheSkyXFacadeForDriversInterface* pTheSkyXForMounts, SleeperInterface* pSleeper, BasicIniUtilInterface* pIniUtilIn, LoggerInterface* pLoggerIn, MutexInterface* pIOMutex)
 {
-	static auto instance = new AlumaX2{ nISIndex, pTheSkyXForMounts, pSleeper, pIniUtilIn, pLoggerIn, pIOMutex };
+	std::lock_guard<std::mutex> lock(s_instancesMutex);
+	auto& instance = s_instances[nISIndex];
+	if (instance == nullptr)
+	{
+		instance = new AlumaX2{ nISIndex, pTheSkyXForMounts, pSleeper, pIniUtilIn, pLoggerIn, pIOMutex };
+		return instance;
+	}
+
+	//The live object keeps the interfaces it was created with, the ones handed over again are owned by the driver and released
+	if (pTheSkyXForMounts != instance->m_theSkyXFacade)
+		delete pTheSkyXForMounts;
+	if (pSleeper != instance->m_sleeper)
+		delete pSleeper;
+	if (pLoggerIn != instance->m_logger)
+		delete pLoggerIn;
+	if (pIOMutex != instance->m_mutex)
+		delete pIOMutex;
+
 	return instance;
 }
 
@@ -29,16 +86,32 @@ AlumaX2::AlumaX2(
 	LoggerInterface* pLoggerIn,
 	MutexInterface* pIOMutex) :
 	m_isIndex(nISIndex),
+	m_iniRoot(GetIniRoot(nISIndex)),
 	m_theSkyXFacade(pTheSkyXForMounts),
 	m_sleeper(pSleeper),
 	m_iniUtil(pIniUtilIn),
 	m_logger(pLoggerIn),
-	m_mutex(pIOMutex)
+	m_mutex(pIOMutex),
+	m_ioLock("TheSkyX I/O", pIOMutex),
+	m_threadPool(ThreadPool::GetDefaultWorkerCount()),
+	m_statusPoller(m_promiseExecutor),
+	m_filterWheel(m_promiseExecutor),
+	m_guidePort(m_promiseExecutor),
+	m_mainSensor(0, "Main sensor", m_transportMutex, m_promiseExecutor),
+	m_externalSensor(1, "External sensor", m_transportMutex, m_promiseExecutor)
 {
 }
 
 AlumaX2::~AlumaX2()
 {
+	//Removed before anything is released, IsClaimedByOtherInstance walks the map under the same mutex
+	{
+		std::lock_guard<std::mutex> lock(s_instancesMutex);
+		const auto instance = s_instances.find(m_isIndex);
+		if (instance != s_instances.end() && instance->second == this)
+			s_instances.erase(instance);
+	}
+
 	delete m_theSkyXFacade;
 	delete m_sleeper;
 	delete m_logger;
@@ -48,14 +121,16 @@ AlumaX2::~AlumaX2()
 //DriverRootInterface
 int AlumaX2::queryAbstraction(const char* pszName, void** ppVal)
 {
-	X2MutexLocker locker(GetMutex());
-
 	if (!strcmp(pszName, FilterWheelMoveToInterface_Name))
 		* ppVal = dynamic_cast<FilterWheelMoveToInterface*>(this);
 	else if (!strcmp(pszName, SubframeInterface_Name))
 		* ppVal = dynamic_cast<SubframeInterface*>(this);
 	else if (!strcmp(pszName, ModalSettingsDialogInterface_Name))
 		* ppVal = dynamic_cast<ModalSettingsDialogInterface*>(this);
+	else if (!strcmp(pszName, AddFITSKeyInterface_Name))
+		* ppVal = dynamic_cast<AddFITSKeyInterface*>(this);
+	else if (!strcmp(pszName, CameraDependentSettingInterface_Name))
+		* ppVal = dynamic_cast<CameraDependentSettingInterface*>(this);
 
 	return SB_OK;
 }
@@ -63,13 +138,11 @@ int AlumaX2::queryAbstraction(const char* pszName, void** ppVal)
 //DriverInfoInterface
 void AlumaX2::driverInfoDetailedInfo(BasicStringInterface& str) const
 {
-	X2MutexLocker locker(GetMutex());
 	str = DEVICE_DRIVER_INFO_STRING;
 }
 
 double AlumaX2::driverInfoVersion() const
 {
-	X2MutexLocker locker(GetMutex());
 	return 1.0;
 }
 
@@ -77,78 +150,162 @@ double AlumaX2::driverInfoVersion() const
 //HardwareInfoInterface
 void AlumaX2::deviceInfoNameShort(BasicStringInterface& str) const
 {
-	X2MutexLocker locker(GetMutex());
 	str = DEVICE_DRIVER_INFO_STRING;
 }
 
 void AlumaX2::deviceInfoNameLong(BasicStringInterface& str) const
 {
-	X2MutexLocker locker(GetMutex());
 	str = DEVICE_DRIVER_INFO_STRING;
 }
 
 void AlumaX2::deviceInfoDetailedDescription(BasicStringInterface& str) const
 {
-	X2MutexLocker locker(GetMutex());
 	str = DEVICE_DRIVER_INFO_STRING;
 }
 
 void AlumaX2::deviceInfoFirmwareVersion(BasicStringInterface& str)
 {
-	X2MutexLocker locker(GetMutex());
 	str = DEVICE_DRIVER_INFO_STRING;
 }
 
 void AlumaX2::deviceInfoModel(BasicStringInterface& str)
 {
-	X2MutexLocker locker(GetMutex());
 	str = DEVICE_DRIVER_INFO_STRING;
 }
 
 //CameraDriverInterface
 int AlumaX2::CCSettings(const enumCameraIndex& Camera, const enumWhichCCD& CCD)
 {
-	X2MutexLocker locker(GetMutex());
 	return ERR_NOT_IMPL;
 }
 
 int AlumaX2::CCEstablishLink(enumLPTPort portLPT, const enumWhichCCD& CCD, enumCameraIndex DesiredCamera,
 	enumCameraIndex& CameraFound, const int nDesiredCFW, int& nFoundCFW)
 {
-	X2MutexLocker locker(GetMutex());
+	//Linking replaces the camera under every subsystem, so it holds TheSkyX's mutex and all subsystem locks
+	std::lock_guard<ContentionLock> ioLock(m_ioLock);
+	std::lock_guard<ContentionLock> mainSensorLock(m_mainSensor.lock);
+	std::lock_guard<ContentionLock> externalSensorLock(m_externalSensor.lock);
+	std::lock_guard<ContentionLock> tecLock(m_tecLock);
+	std::lock_guard<ContentionLock> filterWheelLock(m_filterWheelLock);
 
 	if (m_bLinked)
 		return SB_OK;
 
-	m_gateway.reset(dl::getGateway(), [](dl::IGateway * gw) { dl::deleteGateway(gw); });
+	const auto connectStart = std::chrono::steady_clock::now();
+
+	//The gateway is kept between links, it owns the device lists a reconnect looks the camera up in
+	if (m_gateway == nullptr)
+		m_gateway.reset(dl::getGateway(), [](dl::IGateway * gw) { dl::deleteGateway(gw); });
+
+	const char* connectPath = "";
+	m_cameraPtr = ConnectCamera(connectPath);
+	if (m_cameraPtr == nullptr)
+	{
+		Log("CCEstablishLink: no camera found");
+		return ERR_NODEVICESELECTED;
+	}
 
-	m_gateway->queryUSBCameras();
-	m_cameraPtr = m_gateway->getUSBCamera(0);
 	m_cameraPtr->initialize();
 
+	//Remembered for the next link, so it can go straight to this camera
+	const auto cameraSerialNumber = m_cameraPtr->getInfo().serialNumber;
+	m_linkedSerialNumber = cameraSerialNumber;
+	m_cameraEndpoint = m_gateway->getCameraConnectionDetails(cameraSerialNumber).endpointType;
+	SetCameraSerialNumber(static_cast<int>(cameraSerialNumber));
+	SetCameraEndpoint(static_cast<int>(m_cameraEndpoint));
+	ApplyDownloadPolicy();
+
+	char serial[128] = { 0 };
+	size_t serialLength = sizeof(serial) - 1;
+	m_cameraPtr->getSerial(&(serial[0]), serialLength);
+	m_cameraSerial = serial;
+
+	const auto connectMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - connectStart).count();
+	char buf[256] = { 0 };
+	snprintf(buf, sizeof(buf), "CCEstablishLink: connected to %s (%s) in %.0f ms", m_cameraSerial.c_str(), connectPath, connectMs);
+	Log(buf);
+
+	//Settings the camera already has from a previous session are not written again
+	m_cameraShadow.Load(m_cameraPtr);
+
+	//The fan mode does not depend on the overscan probing, so it is left in flight meanwhile
 	auto sensor = m_cameraPtr->getSensor(0);
-	HandlePromise(sensor->setSetting(dl::ISensor::AutoFanMode, GetAutoFanMode()));
-	HandlePromise(sensor->setSetting(dl::ISensor::UseOverscan, GetUseOverscan()));
+	const auto fanMode = GetAutoFanMode();
+	PromiseExecutor::Ticket fanModeTicket = 0;
+	if (m_cameraShadow.NeedsSetting(0, dl::ISensor::AutoFanMode, fanMode))
+		fanModeTicket = m_promiseExecutor.Submit(PromiseExecutor::Exposure, [sensor, fanMode] { return sensor->setSetting(dl::ISensor::AutoFanMode, fanMode); });
+	ApplyOverscanSetting(sensor);
+	RefreshCapabilities();
+	if (fanModeTicket != 0 && WaitForPromise(fanModeTicket) == SB_OK)
+		m_cameraShadow.StoreSetting(0, dl::ISensor::AutoFanMode, fanMode);
+
+	ReserveFrameArena();
+	ConfigureCalibrationLibrary();
+	LoadDefectMap();
 
 	m_filterWheelPtr = m_cameraPtr->getFW();
 	if (m_filterWheelPtr != nullptr)
 	{
 		m_filterWheelPtr->initialize();
+		m_filterWheel.Start(m_filterWheelPtr);
 		nFoundCFW = 1;
 	}
 
 	setLinked(true);
 
 	m_flipSensors = false;
+	m_mainSensor.state = SensorChannel::Idle;
+	m_externalSensor.state = SensorChannel::Idle;
+
+	m_statusPoller.Start(m_cameraPtr);
+	m_guidePort.Start(m_cameraPtr);
 
 	return SB_OK;
 }
 
 int AlumaX2::CCDisconnect(const bool bShutDownTemp)
 {
-	X2MutexLocker locker(GetMutex());
+	for (const auto channel : { &m_mainSensor, &m_externalSensor })
+	{
+		if (channel->downloadWorker.IsBusy())
+			WaitForDownload(*channel);
+	}
+
+	m_statusPoller.Stop();
+	m_promiseExecutor.Drain();
+	m_filterWheel.Stop();
+	m_guidePort.Stop();
+
+	{
+		std::lock_guard<ContentionLock> ioLock(m_ioLock);
+		std::lock_guard<ContentionLock> mainSensorLock(m_mainSensor.lock);
+		std::lock_guard<ContentionLock> externalSensorLock(m_externalSensor.lock);
+		std::lock_guard<ContentionLock> tecLock(m_tecLock);
+		std::lock_guard<ContentionLock> filterWheelLock(m_filterWheelLock);
+
+		LogStatusPollerStats();
+		LogPromiseStats();
+		LogCameraShadowStats();
+		LogDownloadStats();
+		LogReadoutStats();
+		LogFilterWheelStats();
+		LogGuidePortStats();
+		m_cameraShadow.Clear();
+		for (const auto channel : { &m_mainSensor, &m_externalSensor })
+		{
+			channel->state = SensorChannel::Idle;
+			channel->capabilities = SensorCapabilities{};
+		}
+		LogFrameArenaStats();
+		LogCalibrationStats();
+		m_calibrationLibrary.Clear();
+		m_linkedSerialNumber = 0;
+		setLinked(false);
+	}
 
-	setLinked(false);
+	//Logged once every lock is released, so the disconnect itself is included
+	LogLockStats();
 
 	return SB_OK;
 }
@@ -156,36 +313,36 @@ int AlumaX2::CCDisconnect(const bool bShutDownTemp)
 int AlumaX2::CCGetChipSize(const enumCameraIndex& Camera, const enumWhichCCD& CCD, const int& nXBin, const int& nYBin,
 	const bool& bOffChipBinning, int& nW, int& nH, int& nReadOut)
 {
-	X2MutexLocker locker(GetMutex());
+	auto& channel = GetChannel(CCD);
+	std::lock_guard<ContentionLock> lock(channel.lock);
 
-	const auto sensorInfo = m_cameraPtr->getSensor(ConvertCCDtoSensorId(CCD))->getInfo();
-	nW = static_cast<int>(sensorInfo.pixelsX / nXBin);
-	nH = static_cast<int>(sensorInfo.pixelsY / nYBin);
+	if (nXBin <= 0 || nYBin <= 0)
+		return ERR_CMDFAILED;
 
-	if (CCD == enumWhichCCD::CCD_IMAGER)
-	{
-		m_imagerBinX = nXBin;
-		m_imagerBinY = nYBin;
-	}
-	else if (CCD == enumWhichCCD::CCD_GUIDER)
-	{
-		m_guiderBinX = nXBin;
-		m_guiderBinY = nYBin;
-	}
+	const auto sensorId = channel.sensorId;
+	const auto& sensorInfo = channel.capabilities.info;
 
+	//Overscan corrected frames are cropped to the active area before they reach TheSkyX
+	const auto isOverscanCorrected = IsOverscanCorrected(sensorId);
+	nW = static_cast<int>((isOverscanCorrected ? m_overscanGeometry.activeX : sensorInfo.pixelsX) / nXBin);
+	nH = static_cast<int>((isOverscanCorrected ? m_overscanGeometry.activeY : sensorInfo.pixelsY) / nYBin);
+
+	//Whatever the sensor cannot bin itself is binned in software after download
+	SplitBinning(nXBin, sensorInfo.maxBinX, bOffChipBinning, channel.binX, channel.softwareBinX);
+	SplitBinning(nYBin, sensorInfo.maxBinY, bOffChipBinning, channel.binY, channel.softwareBinY);
 
 	return SB_OK;
 }
 
 int AlumaX2::CCGetNumBins(const enumCameraIndex& Camera, const enumWhichCCD& CCD, int& nNumBins)
 {
-	X2MutexLocker locker(GetMutex());
+	auto& channel = GetChannel(CCD);
+	std::lock_guard<ContentionLock> lock(channel.lock);
 
-	if (m_cameraPtr == nullptr)
+	if (!channel.capabilities.valid)
 		return ERR_NOLINK;
 
-	const auto sensorInfo = m_cameraPtr->getSensor(ConvertCCDtoSensorId(CCD))->getInfo();
-	nNumBins = static_cast<int>(sensorInfo.maxBinX);
+	nNumBins = static_cast<int>(channel.capabilities.binList.size());
 
 	return SB_OK;
 }
@@ -193,17 +350,14 @@ int AlumaX2::CCGetNumBins(const enumCameraIndex& Camera, const enumWhichCCD& CCD
 int AlumaX2::CCGetBinSizeFromIndex(const enumCameraIndex & Camera, const enumWhichCCD & CCD, const int& nIndex,
 	long& nBincx, long& nBincy)
 {
-	X2MutexLocker locker(GetMutex());
+	auto& channel = GetChannel(CCD);
+	std::lock_guard<ContentionLock> lock(channel.lock);
 
-	switch (nIndex)
-	{
-	case 0:		nBincx = nBincy = 1; break;
-	case 1:		nBincx = nBincy = 2; break;
-	case 2:		nBincx = nBincy = 3; break;
-	case 3:		nBincx = nBincy = 4; break;
-	case 4:		nBincx = nBincy = 5; break;
-	default:	nBincx = nBincy = 1; break;
-	}
+	if (!channel.capabilities.valid)
+		return ERR_NOLINK;
+
+	const auto& binList = channel.capabilities.binList;
+	nBincx = nBincy = (nIndex >= 0 && nIndex < static_cast<int>(binList.size())) ? binList[nIndex] : 1;
 
 	return SB_OK;
 }
@@ -211,7 +365,6 @@ int AlumaX2::CCGetBinSizeFromIndex(const enumCameraIndex & Camera, const enumWhi
 int AlumaX2::CCSetBinnedSubFrame(const enumCameraIndex & Camera, const enumWhichCCD & CCD, const int& nLeft,
 	const int& nTop, const int& nRight, const int& nBottom)
 {
-	X2MutexLocker locker(GetMutex());
 	return SB_OK;
 }
 
@@ -223,7 +376,32 @@ void AlumaX2::CCMakeExposureState(int* pnState, enumCameraIndex Cam, int nXBin,
 int AlumaX2::CCStartExposure(const enumCameraIndex & Cam, const enumWhichCCD CCD, const double& dTime,
 	enumPictureType Type, const int& nABGState, const bool& bLeaveShutterAlone)
 {
-	X2MutexLocker locker(GetMutex());
+	//Equivalent to the first camera dependent setting, the sensor's default readout mode
+	return StartExposure(CCD, dTime, Type, 0);
+}
+
+int AlumaX2::StartExposure(const enumWhichCCD& CCD, const double& dTime, const enumPictureType& Type, const unsigned int& readoutMode)
+{
+	auto& channel = GetChannel(CCD);
+
+	//An early filter move may still be under way, the shutter must not open before the wheel has settled
+	if (channel.sensorId == 0 && GetEarlyFilterMove() != 0)
+	{
+		const auto result = WaitForFilterMove();
+		if (result != SB_OK)
+			return result;
+	}
+
+	std::lock_guard<ContentionLock> lock(channel.lock);
+
+	//The previous frame of this sensor is still being transferred
+	if (channel.state == SensorChannel::Downloading)
+	{
+		char buf[128] = { 0 };
+		snprintf(buf, sizeof(buf), "CCStartExposure: %s is %s", channel.name, SensorChannel::GetStateName(channel.state));
+		Log(buf);
+		return ERR_CMDFAILED;
+	}
 
 	auto isLightFrame = true;
 
@@ -242,30 +420,63 @@ int AlumaX2::CCStartExposure(const enumCameraIndex & Cam, const enumWhichCCD CCD
 		return ERR_CMDFAILED;
 	}
 
+	//Quantized up front, so the calibration key matches the exposure the sensor actually takes
+	const auto duration = channel.capabilities.valid ? channel.capabilities.QuantizeExposure(dTime) : std::max(dTime, 0.0);
+
 	dl::TExposureOptions options{};
-	options.duration = static_cast<float>(dTime);
-	options.binX = CCD == enumWhichCCD::CCD_IMAGER ? m_imagerBinX : m_guiderBinX;
-	options.binY = CCD == enumWhichCCD::CCD_IMAGER ? m_imagerBinY : m_guiderBinY;
-	options.readoutMode = 0;
+	options.duration = static_cast<float>(duration);
+	options.binX = channel.binX;
+	options.binY = channel.binY;
+	options.readoutMode = readoutMode;
 	options.isLightFrame = isLightFrame;
 	options.useRBIPreflash = false;
 	options.useExtTrigger = false;
 
-	return HandlePromise(m_cameraPtr->getSensor(ConvertCCDtoSensorId(CCD))->startExposure(options));
+	auto& exposure = channel.exposure;
+	const auto tec = m_cameraPtr->getTEC();
+	exposure.type = Type;
+	exposure.exposureMs = static_cast<unsigned int>(std::lround(duration * 1000.0));
+	exposure.readoutMode = options.readoutMode;
+	exposure.tecEnabled = tec != nullptr && tec->getEnabled();
+	exposure.setpoint = tec != nullptr ? static_cast<int>(std::lround(tec->getSetpoint())) : 0;
+
+	const auto result = HandlePromise(PromiseExecutor::Exposure, [&] { return m_cameraPtr->getSensor(channel.sensorId)->startExposure(options); });
+	exposure.started = std::chrono::steady_clock::now();
+	channel.state = result == SB_OK ? SensorChannel::Exposing : SensorChannel::Idle;
+	m_statusPoller.Boost();
+
+	return result;
 }
 
 int AlumaX2::CCIsExposureComplete(const enumCameraIndex & Cam, const enumWhichCCD CCD, bool* pbComplete,
 	unsigned* pStatus)
 {
-	X2MutexLocker locker(GetMutex());
+	auto& channel = GetChannel(CCD);
+	std::lock_guard<ContentionLock> lock(channel.lock);
 
-	dl::ICamera::Status status;
-	const auto result = GetCameraStatus(status);
+	StatusPoller::Snapshot snapshot;
+	const auto result = GetStatusSnapshot(snapshot);
 
 	if (result != SB_OK)
 		return result;
 
-	const auto sensorStatus = (ConvertCCDtoSensorId(CCD) == 0) ? status.mainSensorState : status.extSensorState;
+	//A status queried before the exposure was started says nothing about it
+	if (snapshot.queried < channel.exposure.started)
+	{
+		*pbComplete = false;
+		return result;
+	}
+
+	const auto sensorStatus = (channel.sensorId == 0) ? snapshot.status.mainSensorState : snapshot.status.extSensorState;
+
+	if (channel.state == SensorChannel::Exposing && (sensorStatus == dl::ISensor::DoShutterClose || sensorStatus == dl::ISensor::Reading || sensorStatus == dl::ISensor::ReadyToDownload))
+	{
+		channel.state = SensorChannel::Reading;
+
+		//The shutter is closed, a filter move asked for during the exposure runs under readout and download
+		if (channel.sensorId == 0)
+			ReleaseFilterMove();
+	}
 
 	*pbComplete = sensorStatus == dl::ISensor::ReadyToDownload;
 
@@ -275,130 +486,169 @@ int AlumaX2::CCIsExposureComplete(const enumCameraIndex & Cam, const enumWhichCC
 int AlumaX2::CCEndExposure(const enumCameraIndex & Cam, const enumWhichCCD CCD, const bool& bWasAborted,
 	const bool& bLeaveShutterAlone)
 {
-	X2MutexLocker locker(GetMutex());
+	auto& channel = GetChannel(CCD);
 
-	if (bWasAborted)
 	{
-		return HandlePromise(m_cameraPtr->getSensor(ConvertCCDtoSensorId(CCD))->abortExposure());
-	}
+		std::lock_guard<ContentionLock> lock(channel.lock);
 
-	const auto sensor = m_cameraPtr->getSensor(ConvertCCDtoSensorId(CCD));
-	const auto promise = sensor->startDownload();
-	while (!IsTransferCompleted(promise))
-	{
-		m_sleeper->sleep(5);
+		if (bWasAborted)
+		{
+			channel.state = SensorChannel::Idle;
+			const auto result = HandlePromise(PromiseExecutor::Exposure, [&] { return m_cameraPtr->getSensor(channel.sensorId)->abortExposure(); });
+			if (channel.sensorId == 0)
+				ReleaseFilterMove();
+
+			return result;
+		}
+
+		if (channel.sensorId == 0)
+			ReleaseFilterMove();
+
+		if (!channel.downloadWorker.Start(m_cameraPtr->getSensor(channel.sensorId)))
+		{
+			channel.state = SensorChannel::Idle;
+			return ERR_CMDFAILED;
+		}
+
+		channel.state = SensorChannel::Downloading;
 	}
 
-	return SB_OK;
+	//The sensor lock is released while the image is transferred, so the other sensor, telemetry and guiding calls are not blocked
+	const auto result = WaitForDownload(channel);
+
+	std::lock_guard<ContentionLock> lock(channel.lock);
+	channel.state = result == SB_OK ? SensorChannel::Ready : SensorChannel::Idle;
+
+	return result;
 }
 
 int AlumaX2::CCReadoutLine(const enumCameraIndex & Cam, const enumWhichCCD & CCD, const int& pixelStart,
 	const int& pixelLength, const int& nReadoutMode, unsigned char* pMem)
 {
-	X2MutexLocker locker(GetMutex());
 	return ERR_NOT_IMPL;
 }
 
 int AlumaX2::CCDumpLines(const enumCameraIndex & Cam, const enumWhichCCD & CCD, const int& nReadoutMode,
 	const unsigned& lines)
 {
-	X2MutexLocker locker(GetMutex());
 	return SB_OK;
 }
 
 int AlumaX2::CCReadoutImage(const enumCameraIndex & Cam, const enumWhichCCD & CCD, const int& nWidth, const int& nHeight,
 	const int& nMemWidth, unsigned char* pMem)
 {
-	X2MutexLocker locker(GetMutex());
+	auto& channel = GetChannel(CCD);
+	std::lock_guard<ContentionLock> lock(channel.lock);
+
+	if (channel.state == SensorChannel::Downloading || channel.downloadWorker.IsBusy())
+		return ERR_CMDFAILED;
 
-	const auto sensor = m_cameraPtr->getSensor(ConvertCCDtoSensorId(CCD));
+	if (pMem == nullptr || nWidth <= 0 || nHeight <= 0)
+		return ERR_POINTER;
 
-	const auto bufferLength = nWidth * nHeight;
-	const auto image = sensor->getImage();
-	const auto imageBuffer = image->getBufferData();
-	const auto copyLength = sizeof(unsigned short) * bufferLength;
+	const auto image = m_cameraPtr->getSensor(channel.sensorId)->getImage();
+	if (image == nullptr)
+		return ERR_CMDFAILED;
 
-	memmove(pMem, imageBuffer, copyLength);
+	const auto result = CopyImage(channel, image->getBufferData(), image->getBufferLength(), image->getMetadata(), nWidth, nHeight, nMemWidth, pMem);
 
-	return SB_OK;
+	channel.state = SensorChannel::Idle;
+
+	return result;
 }
 
 int AlumaX2::CCRegulateTemp(const bool& bOn, const double& dTemp)
 {
-	X2MutexLocker locker(GetMutex());
+	std::lock_guard<ContentionLock> lock(m_tecLock);
 
 	const auto tec = m_cameraPtr->getTEC();
-	return HandlePromise(tec->setState(bOn, static_cast<float>(dTemp)));
+	const auto setpoint = static_cast<float>(dTemp);
+	if (!m_cameraShadow.NeedsTecState(bOn, setpoint))
+		return SB_OK;
+
+	const auto result = HandlePromise(PromiseExecutor::Exposure, [&] { return tec->setState(bOn, setpoint); });
+	if (result == SB_OK)
+		m_cameraShadow.StoreTecState(bOn, setpoint);
+	m_statusPoller.Boost();
+
+	return result;
 }
 
 int AlumaX2::CCQueryTemperature(double& dCurTemp, double& dCurPower, char* lpszPower, const int nMaxLen,
 	bool& bCurEnabled, double& dCurSetPoint)
 {
-	X2MutexLocker locker(GetMutex());
+	std::lock_guard<ContentionLock> lock(m_tecLock);
 
-	dl::ICamera::Status status;
-	const auto result = GetCameraStatus(status);
+	StatusPoller::Snapshot snapshot;
+	const auto result = GetStatusSnapshot(snapshot);
 
 	if (result != SB_OK)
 		return result;
 
-	dCurTemp = status.sensorTemperature;
-	dCurPower = status.coolerPower;
-
-	const auto tec = m_cameraPtr->getTEC();
-	bCurEnabled = tec->getEnabled();
-	dCurSetPoint = tec->getSetpoint();
+	dCurTemp = snapshot.status.sensorTemperature;
+	dCurPower = snapshot.status.coolerPower;
+	bCurEnabled = snapshot.tecEnabled;
+	dCurSetPoint = snapshot.tecSetpoint;
 
 	return result;
 }
 
 int AlumaX2::CCGetRecommendedSetpoint(double& dRecSP)
 {
-	X2MutexLocker locker(GetMutex());
 	return SB_OK;
 }
 
 int AlumaX2::CCSetFan(const bool& bOn)
 {
-	X2MutexLocker locker(GetMutex());
 	return SB_OK;
 }
 
 int AlumaX2::CCActivateRelays(const int& nXPlus, const int& nXMinus, const int& nYPlus, const int& nYMinus,
 	const bool& bSynchronous, const bool& bAbort, const bool& bEndThread)
 {
-	X2MutexLocker locker(GetMutex());
-	return ERR_NOT_IMPL;
+	//Guiding takes no driver lock, the guide port serializes itself and its commands jump the executor queue
+	if (bEndThread)
+		return SB_OK;
+
+	//Relay durations come in 1/100 s, opposite relays of an axis cancel out
+	std::string error;
+	const auto succeeded = bAbort ? m_guidePort.Abort(error)
+		: m_guidePort.Pulse((nXPlus - nXMinus) * 10, (nYPlus - nYMinus) * 10, bSynchronous, error);
+
+	if (!succeeded)
+	{
+		char buf[256] = { 0 };
+		snprintf(buf, sizeof(buf), "CCActivateRelays: %s", error.c_str());
+		Log(buf);
+		return ERR_CMDFAILED;
+	}
+
+	return SB_OK;
 }
 
 int AlumaX2::CCPulseOut(unsigned nPulse, bool bAdjust, const enumCameraIndex & Cam)
 {
-	X2MutexLocker locker(GetMutex());
 	return ERR_NOT_IMPL;
 
 }
 
 int AlumaX2::CCSetShutter(bool bOpen)
 {
-	X2MutexLocker locker(GetMutex());
 	return SB_OK;
 }
 
 int AlumaX2::CCUpdateClock()
 {
-	X2MutexLocker locker(GetMutex());
 	return SB_OK;
 }
 
 int AlumaX2::CCSetImageProps(const enumCameraIndex & Camera, const enumWhichCCD & CCD, const int& nReadOut, void* pImage)
 {
-	X2MutexLocker locker(GetMutex());
 	return SB_OK;
 }
 
 int AlumaX2::CCGetFullDynamicRange(const enumCameraIndex & Camera, const enumWhichCCD & CCD, unsigned long& dwDynRg)
 {
-	X2MutexLocker locker(GetMutex());
 	return SB_OK;
 }
 
@@ -409,8 +659,6 @@ void AlumaX2::CCBeforeDownload(const enumCameraIndex & Cam, const enumWhichCCD &
 
 void AlumaX2::CCAfterDownload(const enumCameraIndex & Cam, const enumWhichCCD & CCD)
 {
-	X2MutexLocker locker(GetMutex());
-
 	//Wait for the camera driver to cleanup
 	m_sleeper->sleep(100);
 }
@@ -418,29 +666,58 @@ void AlumaX2::CCAfterDownload(const enumCameraIndex & Cam, const enumWhichCCD &
 int AlumaX2::CCSetBinnedSubFrame3(const enumCameraIndex & Camera, const enumWhichCCD & CCDOrig, const int& nLeft,
 	const int& nTop, const int& nWidth, const int& nHeight)
 {
-	X2MutexLocker locker(GetMutex());
+	auto& channel = GetChannel(CCDOrig);
+	std::lock_guard<ContentionLock> lock(channel.lock);
 
 
-	const auto sensor = m_cameraPtr->getSensor(ConvertCCDtoSensorId(CCDOrig));
-	const auto sensorInfo = sensor->getInfo();
+	const auto sensorId = channel.sensorId;
+	const auto sensor = m_cameraPtr->getSensor(sensorId);
 
-	const dl::TSubframe subFrame
+	//TheSkyX works in fully binned pixels, the sensor only sees the hardware part of the binning
+	const auto hardwareBinX = channel.binX;
+	const auto hardwareBinY = channel.binY;
+	const auto softwareBinX = channel.softwareBinX;
+	const auto softwareBinY = channel.softwareBinY;
+
+	dl::TSubframe subFrame
 	{
-		nTop,
-		nLeft,
-		nWidth,
-		nHeight,
-		CCDOrig == enumWhichCCD::CCD_IMAGER ? m_imagerBinX : m_guiderBinX,
-		CCDOrig == enumWhichCCD::CCD_IMAGER ? m_imagerBinY : m_guiderBinY
+		nTop * softwareBinY,
+		nLeft * softwareBinX,
+		nWidth * softwareBinX,
+		nHeight * softwareBinY,
+		hardwareBinX,
+		hardwareBinY
 	};
 
-	return HandlePromise(sensor->setSubframe(subFrame));
+	//A full active frame is widened to include the overscan region needed for the bias estimate
+	if (IsOverscanCorrected(sensorId) && nLeft == 0 && nTop == 0
+		&& static_cast<unsigned int>(nWidth) == m_overscanGeometry.activeX / (hardwareBinX * softwareBinX)
+		&& static_cast<unsigned int>(nHeight) == m_overscanGeometry.activeY / (hardwareBinY * softwareBinY))
+	{
+		subFrame.width = static_cast<int>(m_overscanGeometry.fullX / hardwareBinX);
+		subFrame.height = static_cast<int>(m_overscanGeometry.fullY / hardwareBinY);
+	}
+	else
+		subFrame.left += static_cast<int>(GetOverscanColumns(sensorId, hardwareBinX));
+
+	//A sequence at a fixed frame only sends the subframe once
+	if (!m_cameraShadow.NeedsSubframe(sensorId, subFrame))
+		return SB_OK;
+
+	const auto result = HandlePromise(PromiseExecutor::Exposure, [&] { return sensor->setSubframe(subFrame); });
+	if (result == SB_OK)
+		m_cameraShadow.StoreSubframe(sensorId, subFrame);
+
+	return result;
 }
 
 //FilterWheelMoveToInterface
 int AlumaX2::filterCount(int& nCount)
 {
-	X2MutexLocker locker(GetMutex());
+	std::lock_guard<ContentionLock> lock(m_filterWheelLock);
+
+	if (m_filterWheelPtr == nullptr)
+		return ERR_NODEVICESELECTED;
 
 	nCount = static_cast<int>(m_filterWheelPtr->getSlots());
 
@@ -449,36 +726,48 @@ int AlumaX2::filterCount(int& nCount)
 
 int AlumaX2::startFilterWheelMoveTo(const int& nTargetPosition)
 {
-	X2MutexLocker locker(GetMutex());
+	std::lock_guard<ContentionLock> lock(m_filterWheelLock);
+
+	if (m_filterWheelPtr == nullptr)
+		return ERR_NODEVICESELECTED;
 
-	HandlePromise(m_filterWheelPtr->setPosition(nTargetPosition + 1));
+	//The move is tracked by the controller, a failure surfaces in isCompleteFilterWheelMoveTo
+	//The shadow only learns the new position once the move has completed
+	const auto position = nTargetPosition + 1;
+	if (m_cameraShadow.NeedsFilterPosition(position))
+	{
+		//The exposure leaves the exposing state before it releases the move under m_filterWheelLock, so a deferred move is never missed
+		const auto deferred = GetEarlyFilterMove() != 0 && m_mainSensor.state == SensorChannel::Exposing;
+		m_cameraShadow.ForgetFilterPosition();
+		if (!m_filterWheel.Move(position, deferred))
+			return ERR_NODEVICESELECTED;
+	}
 
 	return SB_OK;
 }
 
 int AlumaX2::isCompleteFilterWheelMoveTo(bool& bComplete) const
 {
-	X2MutexLocker locker(GetMutex());
-
-	const auto result = HandlePromise(m_filterWheelPtr->queryStatus());
-
-	if (result != SB_OK)
-		return result;
-
-	bComplete = m_filterWheelPtr->getStatus() == m_filterWheelPtr->FWIdle;
-
-	return SB_OK;
+	std::lock_guard<ContentionLock> lock(m_filterWheelLock);
+	return PollFilterMove(bComplete, "isCompleteFilterWheelMoveTo");
 }
 
 int AlumaX2::endFilterWheelMoveTo()
 {
-	X2MutexLocker locker(GetMutex());
 	return SB_OK;
 }
 
 int AlumaX2::abortFilterWheelMoveTo()
 {
-	X2MutexLocker locker(GetMutex());
+	std::lock_guard<ContentionLock> lock(m_filterWheelLock);
+
+	//The wheel cannot be stopped, it finishes the move it was sent while the driver stops waiting for it
+	if (m_filterWheel.GetState() == FilterWheelController::Moving)
+		Log("abortFilterWheelMoveTo: the SDK cannot stop the filter wheel, the move in progress is abandoned");
+
+	m_filterWheel.Abort();
+	m_cameraShadow.ForgetFilterPosition();
+
 	return SB_OK;
 }
 
@@ -514,6 +803,36 @@ int AlumaX2::execModalSettingsDialog()
 	//Initialize UI
 	dx->setChecked("fanModeCheckBox", GetAutoFanMode());
 	dx->setChecked("overscanCheckBox", GetUseOverscan());
+	dx->setChecked("largePagesCheckBox", GetLargePages());
+	dx->setChecked("softwareBinAverageCheckBox", GetSoftwareBinAverage());
+	dx->setCurrentIndex("overscanCorrectionComboBox", GetOverscanCorrection());
+	dx->setChecked("applyCalibrationCheckBox", GetApplyCalibration());
+	dx->setChecked("recordCalibrationCheckBox", GetRecordCalibration());
+	dx->setPropertyInt("calibrationBudgetSpinBox", "value", GetCalibrationBudget());
+	dx->setChecked("learnDefectsCheckBox", GetLearnDefects());
+	dx->setChecked("correctDefectsCheckBox", GetCorrectDefects());
+	dx->setChecked("frameStatisticsCheckBox", GetFrameStatistics());
+	dx->setChecked("earlyFilterMoveCheckBox", GetEarlyFilterMove());
+	dx->setChecked("usbRadioButton", GetConnectionMode() == CONNECTION_MODE_USB);
+	dx->setChecked("networkRadioButton", GetConnectionMode() == CONNECTION_MODE_NETWORK);
+	dx->setText("networkAddressLineEdit", GetNetworkAddress().c_str());
+	dx->setPropertyInt("networkPortSpinBox", "value", GetNetworkPort());
+	dx->setPropertyInt("downloadTimeoutSpinBox", "value", GetDownloadTimeout());
+	dx->setPropertyInt("downloadRetriesSpinBox", "value", GetDownloadRetries());
+
+	//Index 0 keeps the remembered camera, discovered cameras are appended after it
+	m_discoveredSerials.clear();
+	dx->comboBoxAppendString("networkCameraComboBox", "Remembered camera");
+	dx->setCurrentIndex("networkCameraComboBox", 0);
+
+	{
+		const auto stats = m_mainSensor.downloadWorker.GetStats();
+		char throughput[128] = "Last download: none";
+		if (stats.downloads > 0)
+			snprintf(throughput, sizeof(throughput), "Last download: %.1f MB/s, average %.1f MB/s",
+				stats.lastThroughputMBps, stats.seconds > 0.0 ? stats.bytes / stats.seconds / 1048576.0 : 0.0);
+		dx->setText("throughputLabel", throughput);
+	}
 
 
 	//Display the user interface
@@ -524,6 +843,47 @@ int AlumaX2::execModalSettingsDialog()
 	{
 		SetAutoFanMode(dx->isChecked("fanModeCheckBox"));
 		SetUseOverscan(dx->isChecked("overscanCheckBox"));
+		SetLargePages(dx->isChecked("largePagesCheckBox"));
+		SetSoftwareBinAverage(dx->isChecked("softwareBinAverageCheckBox"));
+		SetOverscanCorrection(dx->currentIndex("overscanCorrectionComboBox"));
+		SetApplyCalibration(dx->isChecked("applyCalibrationCheckBox"));
+		SetRecordCalibration(dx->isChecked("recordCalibrationCheckBox"));
+		SetLearnDefects(dx->isChecked("learnDefectsCheckBox"));
+		SetCorrectDefects(dx->isChecked("correctDefectsCheckBox"));
+		SetFrameStatistics(dx->isChecked("frameStatisticsCheckBox"));
+		SetEarlyFilterMove(dx->isChecked("earlyFilterMoveCheckBox"));
+
+		auto calibrationBudget = 0;
+		dx->propertyInt("calibrationBudgetSpinBox", "value", calibrationBudget);
+		SetCalibrationBudget(calibrationBudget);
+		ConfigureCalibrationLibrary();
+
+		SetConnectionMode(dx->isChecked("networkRadioButton") ? CONNECTION_MODE_NETWORK : CONNECTION_MODE_USB);
+
+		char networkAddress[256] = { 0 };
+		dx->text("networkAddressLineEdit", &(networkAddress[0]), sizeof(networkAddress));
+		SetNetworkAddress(networkAddress);
+
+		auto networkPort = 0;
+		dx->propertyInt("networkPortSpinBox", "value", networkPort);
+		SetNetworkPort(networkPort);
+
+		auto downloadTimeout = 0;
+		dx->propertyInt("downloadTimeoutSpinBox", "value", downloadTimeout);
+		SetDownloadTimeout(downloadTimeout);
+
+		auto downloadRetries = 0;
+		dx->propertyInt("downloadRetriesSpinBox", "value", downloadRetries);
+		SetDownloadRetries(downloadRetries);
+		ApplyDownloadPolicy();
+
+		//A camera picked from the discovery list is the one the next link goes to
+		const auto cameraIndex = dx->currentIndex("networkCameraComboBox");
+		if (cameraIndex > 0 && static_cast<size_t>(cameraIndex) <= m_discoveredSerials.size())
+		{
+			SetCameraSerialNumber(static_cast<int>(m_discoveredSerials[cameraIndex - 1]));
+			SetCameraEndpoint(dl::Net);
+		}
 	}
 
 
@@ -533,83 +893,1191 @@ int AlumaX2::execModalSettingsDialog()
 //X2GUIEventInterface
 void AlumaX2::uiEvent(X2GUIExchangeInterface * uiex, const char* pszEvent)
 {
+	if (strcmp(pszEvent, "on_discoverPushButton_clicked") == 0)
+		DiscoverNetworkCameras(uiex);
+}
+
+//AddFITSKeyInterface
+int AlumaX2::countOfIntegerFields(int& nCount)
+{
+	auto& channel = GetChannel(enumWhichCCD::CCD_IMAGER);
+	std::lock_guard<ContentionLock> lock(channel.lock);
+	nCount = channel.statistics.valid ? 4 : 0;
+	return SB_OK;
+}
+
+int AlumaX2::valueForIntegerField(int nIndex, BasicStringInterface& sFieldName, BasicStringInterface& sFieldComment, int& nFieldValue)
+{
+	auto& channel = GetChannel(enumWhichCCD::CCD_IMAGER);
+	std::lock_guard<ContentionLock> lock(channel.lock);
+	const auto& statistics = channel.statistics;
+
+	switch (nIndex)
+	{
+	case 0:
+		sFieldName = "STATMIN";
+		sFieldComment = "Minimum pixel value";
+		nFieldValue = statistics.minimum;
+		break;
+	case 1:
+		sFieldName = "STATMAX";
+		sFieldComment = "Maximum pixel value";
+		nFieldValue = statistics.maximum;
+		break;
+	case 2:
+		sFieldName = "STATMED";
+		sFieldComment = "Median pixel value";
+		nFieldValue = statistics.median;
+		break;
+	case 3:
+		sFieldName = "STATSAT";
+		sFieldComment = "Number of saturated pixels";
+		nFieldValue = static_cast<int>(statistics.saturated);
+		break;
+	default:
+		return ERR_INDEX_OUT_OF_RANGE;
+	}
+
+	return SB_OK;
+}
+
+int AlumaX2::countOfDoubleFields(int& nCount)
+{
+	auto& channel = GetChannel(enumWhichCCD::CCD_IMAGER);
+	std::lock_guard<ContentionLock> lock(channel.lock);
+	nCount = channel.statistics.valid ? 2 : 0;
+	return SB_OK;
+}
+
+int AlumaX2::valueForDoubleField(int nIndex, BasicStringInterface& sFieldName, BasicStringInterface& sFieldComment, double& dFieldValue)
+{
+	auto& channel = GetChannel(enumWhichCCD::CCD_IMAGER);
+	std::lock_guard<ContentionLock> lock(channel.lock);
+	const auto& statistics = channel.statistics;
+
+	switch (nIndex)
+	{
+	case 0:
+		sFieldName = "STATMEAN";
+		sFieldComment = "Mean pixel value";
+		dFieldValue = statistics.mean;
+		break;
+	case 1:
+		sFieldName = "STATSTD";
+		sFieldComment = "Standard deviation of the pixel values";
+		dFieldValue = statistics.standardDeviation;
+		break;
+	default:
+		return ERR_INDEX_OUT_OF_RANGE;
+	}
+
+	return SB_OK;
+}
+
+int AlumaX2::countOfStringFields(int& nCount)
+{
+	nCount = 0;
+	return SB_OK;
+}
+
+int AlumaX2::valueForStringField(int nIndex, BasicStringInterface& sFieldName, BasicStringInterface& sFieldComment, BasicStringInterface& sFieldValue)
+{
+	return ERR_INDEX_OUT_OF_RANGE;
+}
+
+//CameraDependentSettingInterface
+int AlumaX2::CCGetExtendedSettingName(const enumCameraIndex& Camera, const enumWhichCCD& CCDOrig, BasicStringInterface& sSettingName)
+{
+	sSettingName = "DL Readout Mode";
+	return SB_OK;
+}
+
+int AlumaX2::CCGetExtendedValueCount(const enumCameraIndex& Camera, const enumWhichCCD& CCDOrig, int& nCount)
+{
+	auto& channel = GetChannel(CCDOrig);
+	std::lock_guard<ContentionLock> lock(channel.lock);
+
+	//Before the first link the modes are not known, only the default one is offered
+	nCount = std::max(static_cast<int>(channel.capabilities.readoutModes.size()), 1);
+
+	return SB_OK;
+}
+
+int AlumaX2::CCGetExtendedValueName(const enumCameraIndex& Camera, const enumWhichCCD& CCDOrig, const int nIndex, BasicStringInterface& sName)
+{
+	auto& channel = GetChannel(CCDOrig);
+	std::lock_guard<ContentionLock> lock(channel.lock);
+
+	const auto& readoutModes = channel.capabilities.readoutModes;
+	if (readoutModes.empty() && nIndex == 0)
+	{
+		sName = "Default";
+		return SB_OK;
+	}
+
+	if (nIndex < 0 || static_cast<size_t>(nIndex) >= readoutModes.size())
+		return ERR_INDEX_OUT_OF_RANGE;
+
+	sName = readoutModes[nIndex].c_str();
+
+	return SB_OK;
+}
+
+int AlumaX2::CCStartExposureAdditionalArgInterface(const enumCameraIndex& Cam, const enumWhichCCD CCD, const double& dTime, enumPictureType Type,
+	const int& nABGState, const bool& bLeaveShutterAlone, const int& nIndex)
+{
+	{
+		auto& channel = GetChannel(CCD);
+		std::lock_guard<ContentionLock> lock(channel.lock);
+
+		const auto modeCount = std::max(channel.capabilities.readoutModes.size(), static_cast<size_t>(1));
+		if (nIndex < 0 || static_cast<size_t>(nIndex) >= modeCount)
+			return ERR_INDEX_OUT_OF_RANGE;
+	}
 
+	//The mode is passed with every exposure, so switching between fast and low noise frames needs no reconnect
+	return StartExposure(CCD, dTime, Type, static_cast<unsigned int>(nIndex));
 }
 
 int AlumaX2::GetAutoFanMode() const
 {
 	//Enable Auto Fan Mode by default
-	return m_iniUtil->readInt(KEY_ALUMAX2_ROOT, KEY_ALUMAX2_AUTO_FAN_MODE, 1);
+	return ReadIntSetting(KEY_ALUMAX2_AUTO_FAN_MODE, 1);
 }
 
 void AlumaX2::SetAutoFanMode(const int& autoFanMode) const
 {
-	m_iniUtil->writeInt(KEY_ALUMAX2_ROOT, KEY_ALUMAX2_AUTO_FAN_MODE, autoFanMode);
+	WriteIntSetting(KEY_ALUMAX2_AUTO_FAN_MODE, autoFanMode);
 }
 
 int AlumaX2::GetUseOverscan() const
 {
 	//Disable Overscan mode by default
-	return m_iniUtil->readInt(KEY_ALUMAX2_ROOT, KEY_ALUMAX2_USE_OVERSCAN, 0);
+	return ReadIntSetting(KEY_ALUMAX2_USE_OVERSCAN, 0);
 }
 
 void AlumaX2::SetUseOverscan(const int& useOverscan) const
 {
-	m_iniUtil->writeInt(KEY_ALUMAX2_ROOT, KEY_ALUMAX2_USE_OVERSCAN, useOverscan);
+	WriteIntSetting(KEY_ALUMAX2_USE_OVERSCAN, useOverscan);
 }
 
+int AlumaX2::GetLargePages() const
+{
+	//Disable Large page backed frame buffers by default
+	return ReadIntSetting(KEY_ALUMAX2_LARGE_PAGES, 0);
+}
 
-//Helpers
-int AlumaX2::GetCameraStatus(dl::ICamera::Status & status) const
+void AlumaX2::SetLargePages(const int& largePages) const
+{
+	WriteIntSetting(KEY_ALUMAX2_LARGE_PAGES, largePages);
+}
+
+int AlumaX2::GetSoftwareBinAverage() const
 {
-	const auto result = HandlePromise(m_cameraPtr->queryStatus());
+	//Sum software binned pixels by default, like on-chip binning does
+	return ReadIntSetting(KEY_ALUMAX2_SOFTWARE_BIN_AVERAGE, 0);
+}
 
-	if (result != SB_OK)
-		return result;
+void AlumaX2::SetSoftwareBinAverage(const int& softwareBinAverage) const
+{
+	WriteIntSetting(KEY_ALUMAX2_SOFTWARE_BIN_AVERAGE, softwareBinAverage);
+}
 
-	status = m_cameraPtr->getStatus();
-	return result;
+int AlumaX2::GetOverscanCorrection() const
+{
+	//Pass the overscan region through uncorrected by default
+	return ReadIntSetting(KEY_ALUMAX2_OVERSCAN_CORRECTION, OverscanCorrection::Off);
 }
 
-int AlumaX2::HandlePromise(const dl::IPromisePtr & promise) const
+void AlumaX2::SetOverscanCorrection(const int& overscanCorrection) const
 {
-	const auto result = promise->wait();
-	if (result != dl::IPromise::Complete)
-	{
-		char buf[512] = { 0 };
-		size_t lng = 512;
-		promise->getLastError(&(buf[0]), lng);
-		promise->release();
+	WriteIntSetting(KEY_ALUMAX2_OVERSCAN_CORRECTION, overscanCorrection);
+}
 
-		m_logger->out(std::string(&(buf[0]), lng).c_str());
-		return ERR_CMDFAILED;
-	}
-	promise->release();
+int AlumaX2::GetApplyCalibration() const
+{
+	//Leave calibration to the imaging software by default
+	return ReadIntSetting(KEY_ALUMAX2_APPLY_CALIBRATION, 0);
+}
 
-	return SB_OK;
+void AlumaX2::SetApplyCalibration(const int& applyCalibration) const
+{
+	WriteIntSetting(KEY_ALUMAX2_APPLY_CALIBRATION, applyCalibration);
 }
 
-bool AlumaX2::IsTransferCompleted(const dl::IPromisePtr & promise)
+int AlumaX2::GetRecordCalibration() const
 {
-	const auto status = promise->getStatus();
-	if (status == dl::IPromise::Complete)
-	{
-		promise->release();
-		return true;
-	}
+	//Do not build masters from dark and bias frames by default
+	return ReadIntSetting(KEY_ALUMAX2_RECORD_CALIBRATION, 0);
+}
 
-	if (status == dl::IPromise::Error)
-	{
-		char buf[512] = { 0 };
-		size_t lng = 512;
-		promise->getLastError(&(buf[0]), lng);
-		promise->release();
-		throw std::logic_error(&(buf[0]));
-	}
+void AlumaX2::SetRecordCalibration(const int& recordCalibration) const
+{
+	WriteIntSetting(KEY_ALUMAX2_RECORD_CALIBRATION, recordCalibration);
+}
 
-	return false;
+int AlumaX2::GetCalibrationBudget() const
+{
+	//Keep up to 512 MB of masters mapped by default
+	return ReadIntSetting(KEY_ALUMAX2_CALIBRATION_BUDGET, 512);
 }
-unsigned int AlumaX2::ConvertCCDtoSensorId(const enumWhichCCD & CCD) const
+
+void AlumaX2::SetCalibrationBudget(const int& calibrationBudget) const
 {
-	return GetFlipSensors() ? (CCD == enumWhichCCD::CCD_GUIDER ? 0 : 1) : (CCD == enumWhichCCD::CCD_IMAGER ? 0 : 1);
+	WriteIntSetting(KEY_ALUMAX2_CALIBRATION_BUDGET, calibrationBudget);
+}
+
+int AlumaX2::GetLearnDefects() const
+{
+	//Do not map hot pixels from dark and bias frames by default
+	return ReadIntSetting(KEY_ALUMAX2_LEARN_DEFECTS, 0);
+}
+
+void AlumaX2::SetLearnDefects(const int& learnDefects) const
+{
+	WriteIntSetting(KEY_ALUMAX2_LEARN_DEFECTS, learnDefects);
+}
+
+int AlumaX2::GetCorrectDefects() const
+{
+	//Leave hot pixels in light frames by default
+	return ReadIntSetting(KEY_ALUMAX2_CORRECT_DEFECTS, 0);
+}
+
+void AlumaX2::SetCorrectDefects(const int& correctDefects) const
+{
+	WriteIntSetting(KEY_ALUMAX2_CORRECT_DEFECTS, correctDefects);
+}
+
+int AlumaX2::GetFrameStatistics() const
+{
+	//Add frame statistics to the FITS header by default, they are gathered during the copy
+	return ReadIntSetting(KEY_ALUMAX2_FRAME_STATISTICS, 1);
+}
+
+void AlumaX2::SetFrameStatistics(const int& frameStatistics) const
+{
+	WriteIntSetting(KEY_ALUMAX2_FRAME_STATISTICS, frameStatistics);
+}
+
+int AlumaX2::GetEarlyFilterMove() const
+{
+	//Move the filter wheel when TheSkyX asks by default
+	return ReadIntSetting(KEY_ALUMAX2_EARLY_FILTER_MOVE, 0);
+}
+
+void AlumaX2::SetEarlyFilterMove(const int& earlyFilterMove) const
+{
+	WriteIntSetting(KEY_ALUMAX2_EARLY_FILTER_MOVE, earlyFilterMove);
+}
+
+int AlumaX2::GetCameraSerialNumber() const
+{
+	//No camera remembered by default, the first one discovered is used
+	return ReadIntSetting(KEY_ALUMAX2_CAMERA_SERIAL_NUMBER, 0);
+}
+
+void AlumaX2::SetCameraSerialNumber(const int& cameraSerialNumber) const
+{
+	WriteIntSetting(KEY_ALUMAX2_CAMERA_SERIAL_NUMBER, cameraSerialNumber);
+}
+
+int AlumaX2::GetCameraEndpoint() const
+{
+	//Unknown endpoint by default, which always goes through discovery
+	return ReadIntSetting(KEY_ALUMAX2_CAMERA_ENDPOINT, dl::InvalidEndpoint);
+}
+
+void AlumaX2::SetCameraEndpoint(const int& cameraEndpoint) const
+{
+	WriteIntSetting(KEY_ALUMAX2_CAMERA_ENDPOINT, cameraEndpoint);
+}
+
+int AlumaX2::GetConnectionMode() const
+{
+	//Connect over USB by default
+	return ReadIntSetting(KEY_ALUMAX2_CONNECTION_MODE, CONNECTION_MODE_USB);
+}
+
+void AlumaX2::SetConnectionMode(const int& connectionMode) const
+{
+	WriteIntSetting(KEY_ALUMAX2_CONNECTION_MODE, connectionMode);
+}
+
+std::string AlumaX2::GetNetworkAddress() const
+{
+	//No address by default, network cameras are found by the broadcast sweep
+	std::lock_guard<ContentionLock> lock(m_settingsLock);
+	char buf[256] = { 0 };
+	m_iniUtil->readString(m_iniRoot.c_str(), KEY_ALUMAX2_NETWORK_ADDRESS, "", &(buf[0]), sizeof(buf));
+	return buf;
+}
+
+void AlumaX2::SetNetworkAddress(const std::string& networkAddress) const
+{
+	std::lock_guard<ContentionLock> lock(m_settingsLock);
+	m_iniUtil->writeString(m_iniRoot.c_str(), KEY_ALUMAX2_NETWORK_ADDRESS, networkAddress.c_str());
+}
+
+int AlumaX2::GetNetworkPort() const
+{
+	//No port by default, it is only needed together with an address
+	return ReadIntSetting(KEY_ALUMAX2_NETWORK_PORT, 0);
+}
+
+void AlumaX2::SetNetworkPort(const int& networkPort) const
+{
+	WriteIntSetting(KEY_ALUMAX2_NETWORK_PORT, networkPort);
+}
+
+int AlumaX2::GetDownloadTimeout() const
+{
+	//Give a network download 60 s, enough for a full frame over a slow Wi-Fi link
+	return ReadIntSetting(KEY_ALUMAX2_DOWNLOAD_TIMEOUT, 60);
+}
+
+void AlumaX2::SetDownloadTimeout(const int& downloadTimeout) const
+{
+	WriteIntSetting(KEY_ALUMAX2_DOWNLOAD_TIMEOUT, downloadTimeout);
+}
+
+int AlumaX2::GetDownloadRetries() const
+{
+	//Ask for a failed network download twice more by default
+	return ReadIntSetting(KEY_ALUMAX2_DOWNLOAD_RETRIES, 2);
+}
+
+void AlumaX2::SetDownloadRetries(const int& downloadRetries) const
+{
+	WriteIntSetting(KEY_ALUMAX2_DOWNLOAD_RETRIES, downloadRetries);
+}
+
+std::string AlumaX2::GetCalibrationDirectory() const
+{
+	//Store masters next to TheSkyX's configuration files by default
+	char configPath[1024] = { 0 };
+	m_theSkyXFacade->pathToWriteConfigFilesTo(&(configPath[0]), sizeof(configPath));
+	const auto defaultDirectory = configPath[0] != 0 ? std::string(configPath) + "/AlumaX2Calibration" : std::string();
+
+	std::lock_guard<ContentionLock> lock(m_settingsLock);
+	char buf[1024] = { 0 };
+	m_iniUtil->readString(m_iniRoot.c_str(), KEY_ALUMAX2_CALIBRATION_DIRECTORY, defaultDirectory.c_str(), &(buf[0]), sizeof(buf));
+	return buf;
+}
+
+int AlumaX2::ReadIntSetting(const char* key, const int& defaultValue) const
+{
+	std::lock_guard<ContentionLock> lock(m_settingsLock);
+	return m_iniUtil->readInt(m_iniRoot.c_str(), key, defaultValue);
+}
+
+void AlumaX2::WriteIntSetting(const char* key, const int& value) const
+{
+	std::lock_guard<ContentionLock> lock(m_settingsLock);
+	m_iniUtil->writeInt(m_iniRoot.c_str(), key, value);
+}
+
+
+//Helpers
+dl::ICameraPtr AlumaX2::ConnectCamera(const char*& path)
+{
+	std::lock_guard<std::mutex> discoveryLock(s_discoveryMutex);
+
+	const auto serialNumber = static_cast<unsigned int>(GetCameraSerialNumber());
+
+	if (GetConnectionMode() == CONNECTION_MODE_NETWORK)
+		return ConnectNetworkCamera(serialNumber, path);
+
+	//A camera remembered on USB is found by the quick USB enumeration alone, without waiting on the network sweep
+	if (serialNumber != 0 && GetCameraEndpoint() == dl::USB)
+	{
+		m_gateway->queryUSBCameras();
+		path = "USB, remembered";
+		const auto camera = FindCamera(serialNumber);
+		if (camera != nullptr)
+			return camera;
+	}
+
+	//Fall back to discovering both transports at once, the network sweep takes about 2 s
+	auto netDiscovery = std::async(std::launch::async, [gateway = m_gateway] { gateway->queryNetCameras(); });
+	m_gateway->queryUSBCameras();
+	netDiscovery.wait();
+
+	if (serialNumber != 0)
+	{
+		path = "discovered, remembered";
+		const auto camera = FindCamera(serialNumber);
+		if (camera != nullptr)
+			return camera;
+	}
+
+	path = "USB, discovered";
+	auto camera = FindUnclaimedCamera(dl::USB);
+	if (camera != nullptr)
+		return camera;
+
+	path = "network, discovered";
+	return FindUnclaimedCamera(dl::Net);
+}
+
+dl::ICameraPtr AlumaX2::ConnectNetworkCamera(const unsigned int& serialNumber, const char*& path)
+{
+	//A configured address is asked directly, which also reaches cameras the broadcast sweep does not
+	const auto address = GetNetworkAddress();
+	const auto port = GetNetworkPort();
+	if (!address.empty() && port > 0)
+	{
+		path = "network, configured address";
+		m_gateway->queryNetCamera(address.c_str(), static_cast<size_t>(port));
+		return m_gateway->getNetCamera(address.c_str(), static_cast<unsigned int>(port));
+	}
+
+	m_gateway->queryNetCameras();
+
+	if (serialNumber != 0)
+	{
+		path = "network, remembered";
+		const auto camera = FindCamera(serialNumber, dl::Net);
+		if (camera != nullptr)
+			return camera;
+	}
+
+	path = "network, discovered";
+	return FindUnclaimedCamera(dl::Net);
+}
+
+dl::ICameraPtr AlumaX2::FindCamera(const unsigned int& serialNumber, const dl::EEndpointType& endpoint) const
+{
+	//The gateway also remembers cameras from earlier queries, so the endpoint can be pinned
+	const auto details = m_gateway->getCameraConnectionDetails(serialNumber);
+	if (details.endpointType == dl::InvalidEndpoint || (endpoint != dl::InvalidEndpoint && details.endpointType != endpoint))
+		return nullptr;
+
+	return m_gateway->getCamera(details);
+}
+
+dl::ICameraPtr AlumaX2::FindUnclaimedCamera(const dl::EEndpointType& endpoint) const
+{
+	//Without a remembered camera the first one found is taken, skipping cameras other instances are linked to
+	const auto count = endpoint == dl::USB ? m_gateway->getUSBCameraCount() : m_gateway->getNetCameraCount();
+	for (unsigned int id = 0; id < count; ++id)
+	{
+		const auto camera = endpoint == dl::USB ? m_gateway->getUSBCamera(id) : m_gateway->getNetCamera(id);
+		if (camera != nullptr && !IsClaimedByOtherInstance(camera->getInfo().serialNumber))
+			return camera;
+	}
+
+	return nullptr;
+}
+
+bool AlumaX2::IsClaimedByOtherInstance(const unsigned int& serialNumber) const
+{
+	std::lock_guard<std::mutex> lock(s_instancesMutex);
+	return std::any_of(s_instances.begin(), s_instances.end(), [this, &serialNumber](const std::pair<const int, AlumaX2*>& instance)
+		{
+			return instance.second != this && instance.second->m_linkedSerialNumber == serialNumber;
+		});
+}
+
+void AlumaX2::ApplyDownloadPolicy()
+{
+	//USB transfers are reliable, only network ones get retries and a deadline
+	DownloadWorker::Policy policy;
+	if (m_cameraEndpoint == dl::Net)
+	{
+		policy.attempts = 1 + static_cast<unsigned int>(std::max(GetDownloadRetries(), 0));
+		policy.timeout = std::chrono::seconds(std::max(GetDownloadTimeout(), 0));
+	}
+
+	m_mainSensor.downloadWorker.SetPolicy(policy);
+	m_externalSensor.downloadWorker.SetPolicy(policy);
+}
+
+void AlumaX2::DiscoverNetworkCameras(X2GUIExchangeInterface* uiex)
+{
+	//Holds its own reference on the gateway, the dialog can run before this instance ever linked
+	std::lock_guard<std::mutex> discoveryLock(s_discoveryMutex);
+	std::unique_ptr<dl::IGateway, void(*)(dl::IGateway*)> gateway(dl::getGateway(), [](dl::IGateway* gw) { dl::deleteGateway(gw); });
+	gateway->queryNetCameras();
+
+	auto found = 0;
+	for (unsigned int id = 0; id < gateway->getNetCameraCount(); ++id)
+	{
+		const auto camera = gateway->getNetCamera(id);
+		if (camera == nullptr)
+			continue;
+
+		const auto serialNumber = camera->getInfo().serialNumber;
+		++found;
+		if (std::find(m_discoveredSerials.begin(), m_discoveredSerials.end(), serialNumber) != m_discoveredSerials.end())
+			continue;
+
+		char serial[128] = { 0 };
+		size_t serialLength = sizeof(serial) - 1;
+		camera->getSerial(&(serial[0]), serialLength);
+
+		m_discoveredSerials.push_back(serialNumber);
+		uiex->comboBoxAppendString("networkCameraComboBox", serial);
+	}
+
+	if (found == 0)
+		uiex->messageBox("Discover", "No network cameras found. Cameras on another subnet can be reached by entering their address and port.");
+	else
+		uiex->setCurrentIndex("networkCameraComboBox", static_cast<int>(m_discoveredSerials.size()));
+}
+
+int AlumaX2::GetCameraStatus(dl::ICamera::Status & status) const
+{
+	const auto result = HandlePromise(PromiseExecutor::Telemetry, [&] { return m_cameraPtr->queryStatus(); });
+
+	if (result != SB_OK)
+		return result;
+
+	status = m_cameraPtr->getStatus();
+	return result;
+}
+
+int AlumaX2::GetStatusSnapshot(StatusPoller::Snapshot& snapshot) const
+{
+	snapshot = m_statusPoller.Read();
+
+	if (snapshot.valid && snapshot.failed)
+	{
+		Log(m_statusPoller.GetLastError().c_str());
+		return ERR_CMDFAILED;
+	}
+
+	if (snapshot.valid)
+		return SB_OK;
+
+	//Before the poller has completed its first query the camera is asked directly
+	const auto result = GetCameraStatus(snapshot.status);
+	if (result != SB_OK)
+		return result;
+
+	const auto tec = m_cameraPtr->getTEC();
+	snapshot.valid = true;
+	snapshot.queried = std::chrono::steady_clock::now();
+	snapshot.tecEnabled = tec->getEnabled();
+	snapshot.tecSetpoint = tec->getSetpoint();
+
+	return result;
+}
+
+int AlumaX2::HandlePromise(const PromiseExecutor::Priority& priority, const PromiseExecutor::Issue& issue) const
+{
+	return WaitForPromise(m_promiseExecutor.Submit(priority, issue));
+}
+
+int AlumaX2::WaitForPromise(const PromiseExecutor::Ticket& ticket) const
+{
+	std::string error;
+	if (m_promiseExecutor.Wait(ticket, error))
+		return SB_OK;
+
+	Log(error.c_str());
+	return ERR_CMDFAILED;
+}
+
+int AlumaX2::SetSensorSetting(const dl::ISensorPtr& sensor, const dl::ISensor::Setting& setting, const int& value)
+{
+	const auto sensorId = sensor->getSensorId();
+	if (!m_cameraShadow.NeedsSetting(sensorId, setting, value))
+		return SB_OK;
+
+	const auto result = HandlePromise(PromiseExecutor::Exposure, [&] { return sensor->setSetting(setting, value); });
+	if (result == SB_OK)
+		m_cameraShadow.StoreSetting(sensorId, setting, value);
+
+	return result;
+}
+
+int AlumaX2::CopyImage(SensorChannel& channel, const unsigned short* source, const size_t& length, const dl::TImageMetadata& metadata,
+	const int& nWidth, const int& nHeight, const int& nMemWidth, unsigned char* pMem)
+{
+	const auto sensorId = channel.sensorId;
+	const auto& exposure = channel.exposure;
+	const unsigned int softwareBinX = channel.softwareBinX;
+	const unsigned int softwareBinY = channel.softwareBinY;
+	const auto width = static_cast<unsigned int>(nWidth);
+	const auto height = static_cast<unsigned int>(nHeight);
+	const auto isSoftwareBinned = softwareBinX > 1 || softwareBinY > 1;
+
+	//Size of the frame once the overscan is cropped, software binning drops the partial bins at the right and bottom edges
+	auto frameWidth = metadata.width;
+	auto frameHeight = metadata.height;
+	const auto overscanMode = PlanOverscanCorrection(sensorId, metadata, frameWidth, frameHeight);
+
+	if (frameWidth / softwareBinX != width || frameHeight / softwareBinY != height || length < static_cast<size_t>(metadata.width) * metadata.height)
+	{
+		char buf[256] = { 0 };
+		snprintf(buf, sizeof(buf), "CCReadoutImage: requested %ux%u but the downloaded image is %ux%u", width, height, metadata.width, metadata.height);
+		Log(buf);
+		return ERR_CMDFAILED;
+	}
+
+	//nMemWidth is the destination row size in bytes
+	const auto rowBytes = sizeof(unsigned short) * width;
+	const auto dstStride = static_cast<size_t>(std::max(nMemWidth, 0));
+
+	if (dstStride < rowBytes || dstStride % sizeof(unsigned short) != 0)
+	{
+		char buf[256] = { 0 };
+		snprintf(buf, sizeof(buf), "CCReadoutImage: a row of %zu bytes does not fit the %d byte destination row", rowBytes, nMemWidth);
+		Log(buf);
+		return ERR_CMDFAILED;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	//Light frames get their matching master subtracted, dark and bias frames are folded into theirs
+	//Masters and defect maps are kept for the main sensor only
+	const auto isMainSensor = sensorId == 0;
+	const auto isMasterFrame = isMainSensor && (exposure.type == PT_DARK || exposure.type == PT_BIAS);
+	const auto isLightFrame = isMainSensor && (exposure.type == PT_LIGHT || exposure.type == PT_FLAT);
+	const auto applyCalibration = isLightFrame && GetApplyCalibration() != 0;
+	const auto recordCalibration = isMasterFrame && GetRecordCalibration() != 0;
+	const auto learnDefects = isMasterFrame && GetLearnDefects() != 0;
+	const auto correctDefects = isLightFrame && GetCorrectDefects() != 0;
+
+	//Processing stages run on a working copy, which is TheSkyX's buffer itself unless the frame still has to be binned
+	const auto hasStages = overscanMode != OverscanCorrection::Off || applyCalibration || recordCalibration || learnDefects || correctDefects;
+	auto binSource = source;
+	size_t binSourceStride = metadata.width;
+	auto calibration = CalibrationLibrary::None;
+	size_t correctedDefects = 0;
+	FrameArena::Buffer scratch(m_frameArena);
+
+	//Statistics describe the frame TheSkyX receives, a plain copy gathers them on the way
+	const auto measureStatistics = GetFrameStatistics() != 0;
+	channel.statistics = FrameStatistics::Result{};
+
+	if (!isSoftwareBinned || hasStages)
+	{
+		if (isSoftwareBinned && scratch.Acquire() == nullptr)
+		{
+			Log("CCReadoutImage: no frame buffer available for processing");
+			return ERR_MEMORY;
+		}
+
+		const auto working = isSoftwareBinned ? scratch.Get() : reinterpret_cast<unsigned short*>(pMem);
+		const auto workingStride = isSoftwareBinned ? frameWidth : dstStride / sizeof(unsigned short);
+
+		if (overscanMode != OverscanCorrection::Off)
+			OverscanCorrection::Apply(m_threadPool, source, metadata.width, metadata.width - frameWidth, frameWidth, frameHeight, overscanMode, working, workingStride);
+		else if (measureStatistics && !hasStages && !isSoftwareBinned)
+			channel.statistics = FrameStatistics::CopyRows(m_threadPool, working, workingStride, source, metadata.width, frameWidth, frameHeight, SATURATION_LEVEL);
+		else
+			ImageCopy::CopyRows(m_threadPool, reinterpret_cast<unsigned char*>(working), sizeof(unsigned short) * workingStride,
+				reinterpret_cast<const unsigned char*>(source), sizeof(unsigned short) * metadata.width, sizeof(unsigned short) * frameWidth, frameHeight);
+
+		//A cropped frame starts at the active origin, a subframe passed through is shifted by the overscan columns
+		const auto overscanColumns = overscanMode == OverscanCorrection::Off ? GetOverscanColumns(sensorId, metadata.binX) : 0;
+		const auto activeOffsetX = metadata.offsetX - std::min(metadata.offsetX, overscanColumns);
+
+		DefectMap::Geometry geometry;
+		geometry.binX = std::max(metadata.binX, 1u);
+		geometry.binY = std::max(metadata.binY, 1u);
+		geometry.offsetX = activeOffsetX;
+		geometry.offsetY = metadata.offsetY;
+		geometry.width = frameWidth;
+		geometry.height = frameHeight;
+
+		//Defects are learned from the raw dark, before it is folded into its master
+		if (learnDefects && m_defectMap.Learn(working, workingStride, geometry))
+		{
+			char buf[128] = { 0 };
+			snprintf(buf, sizeof(buf), "DefectMap: %zu defective pixels mapped", m_defectMap.GetDefectCount());
+			Log(buf);
+		}
+
+		if (applyCalibration || recordCalibration)
+		{
+			CalibrationLibrary::Key key;
+			key.serial = m_cameraSerial;
+			key.binX = std::max(metadata.binX, 1u);
+			key.binY = std::max(metadata.binY, 1u);
+			key.offsetX = activeOffsetX;
+			key.offsetY = metadata.offsetY;
+			key.width = frameWidth;
+			key.height = frameHeight;
+			key.readoutMode = exposure.readoutMode;
+			key.exposureMs = exposure.exposureMs;
+			key.tecEnabled = exposure.tecEnabled;
+			key.setpoint = exposure.setpoint;
+
+			if (applyCalibration)
+				calibration = m_calibrationLibrary.Apply(m_threadPool, key, working, workingStride);
+			else
+				m_calibrationLibrary.Record(key, exposure.type == PT_DARK ? CalibrationLibrary::Dark : CalibrationLibrary::Bias, working, workingStride);
+		}
+
+		if (correctDefects)
+			correctedDefects = m_defectMap.Correct(working, workingStride, geometry);
+
+		binSource = working;
+		binSourceStride = workingStride;
+	}
+
+	if (isSoftwareBinned)
+	{
+		const auto mode = GetSoftwareBinAverage() ? SoftwareBinning::Average : SoftwareBinning::Sum;
+		SoftwareBinning::Bin(m_threadPool, binSource, binSourceStride, reinterpret_cast<unsigned short*>(pMem), dstStride / sizeof(unsigned short),
+			width, height, softwareBinX, softwareBinY, mode);
+	}
+
+	if (measureStatistics && !channel.statistics.valid)
+		channel.statistics = FrameStatistics::Measure(m_threadPool, reinterpret_cast<const unsigned short*>(pMem), dstStride / sizeof(unsigned short),
+			width, height, SATURATION_LEVEL);
+
+	const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	auto& stats = channel.readoutStats;
+	++stats.readouts;
+	stats.seconds += elapsed;
+	stats.maxSeconds = std::max(stats.maxSeconds, elapsed);
+	stats.bytes += sizeof(unsigned short) * static_cast<double>(metadata.width) * metadata.height;
+	stats.calibratedFrames += calibration != CalibrationLibrary::None ? 1 : 0;
+	stats.correctedDefects += correctedDefects;
+
+	return SB_OK;
+}
+
+OverscanCorrection::Mode AlumaX2::PlanOverscanCorrection(const unsigned int& sensorId, const dl::TImageMetadata& metadata,
+	unsigned int& frameWidth, unsigned int& frameHeight) const
+{
+	if (!IsOverscanCorrected(sensorId))
+		return OverscanCorrection::Off;
+
+	//Only full frames carry the overscan region, subframes are passed through untouched
+	const auto binX = std::max(metadata.binX, 1u);
+	const auto binY = std::max(metadata.binY, 1u);
+	if (metadata.offsetX != 0 || metadata.offsetY != 0
+		|| metadata.width != m_overscanGeometry.fullX / binX || metadata.height != m_overscanGeometry.fullY / binY)
+		return OverscanCorrection::Off;
+
+	frameWidth = m_overscanGeometry.activeX / binX;
+	frameHeight = m_overscanGeometry.activeY / binY;
+
+	return static_cast<OverscanCorrection::Mode>(GetOverscanCorrection());
+}
+
+unsigned int AlumaX2::GetOverscanColumns(const unsigned int& sensorId, const unsigned int& bin) const
+{
+	//With the overscan on the SDK puts pixel [0,0] at the origin of the overscan region, so its columns lead the active area
+	return IsOverscanCorrected(sensorId) ? (m_overscanGeometry.fullX - m_overscanGeometry.activeX) / std::max(bin, 1u) : 0;
+}
+
+bool AlumaX2::IsOverscanCorrected(const unsigned int& sensorId) const
+{
+	//Overscan is only enabled on the main sensor
+	return sensorId == 0 && m_overscanGeometry.valid && GetOverscanCorrection() != OverscanCorrection::Off;
+}
+
+void AlumaX2::ApplyOverscanSetting(const dl::ISensorPtr& sensor)
+{
+	m_overscanGeometry = OverscanGeometry{};
+
+	if (!GetUseOverscan())
+	{
+		SetSensorSetting(sensor, dl::ISensor::UseOverscan, 0);
+		return;
+	}
+
+	//The geometry measured at an earlier link still holds while the camera reports the same full frame with the overscan on
+	const auto serialNumber = m_linkedSerialNumber.load();
+	const auto currentInfo = sensor->getInfo();
+	if (m_measuredOverscan.serialNumber == serialNumber && !m_cameraShadow.NeedsSetting(0, dl::ISensor::UseOverscan, 1)
+		&& currentInfo.pixelsX == m_measuredOverscan.fullX && currentInfo.pixelsY == m_measuredOverscan.fullY)
+	{
+		m_overscanGeometry = m_measuredOverscan;
+		return;
+	}
+
+	//The overscan region is the difference between the sensor geometry with and without it
+	SetSensorSetting(sensor, dl::ISensor::UseOverscan, 0);
+	HandlePromise(PromiseExecutor::Exposure, [&] { return sensor->queryInfo(); });
+	const auto activeInfo = sensor->getInfo();
+
+	SetSensorSetting(sensor, dl::ISensor::UseOverscan, 1);
+	HandlePromise(PromiseExecutor::Exposure, [&] { return sensor->queryInfo(); });
+	const auto fullInfo = sensor->getInfo();
+	m_cameraShadow.ForgetSubframe(0);
+
+	m_measuredOverscan = OverscanGeometry{};
+	if (fullInfo.pixelsX < activeInfo.pixelsX || fullInfo.pixelsY < activeInfo.pixelsY)
+		return;
+
+	//Overscan rows would be cropped without being used as bias, only overscan columns are supported
+	if (fullInfo.pixelsY != activeInfo.pixelsY)
+	{
+		char buf[256] = { 0 };
+		snprintf(buf, sizeof(buf), "CCEstablishLink: the overscan adds %u rows, overscan correction is not applied", fullInfo.pixelsY - activeInfo.pixelsY);
+		Log(buf);
+		return;
+	}
+
+	m_overscanGeometry.valid = fullInfo.pixelsX > activeInfo.pixelsX;
+	m_overscanGeometry.activeX = activeInfo.pixelsX;
+	m_overscanGeometry.activeY = activeInfo.pixelsY;
+	m_overscanGeometry.fullX = fullInfo.pixelsX;
+	m_overscanGeometry.fullY = fullInfo.pixelsY;
+	m_overscanGeometry.serialNumber = serialNumber;
+	m_measuredOverscan = m_overscanGeometry;
+}
+
+void AlumaX2::RefreshCapabilities()
+{
+	//Runs after the overscan setting has been applied, the only setting that changes the sensor geometry
+	const auto sensorCount = std::max<unsigned int>(m_cameraPtr->getInfo().numberOfSensors, 1);
+	for (const auto channel : { &m_mainSensor, &m_externalSensor })
+	{
+		channel->capabilities = channel->sensorId < sensorCount ? SensorCapabilities::Read(m_cameraPtr->getSensor(channel->sensorId)) : SensorCapabilities{};
+
+		if (!channel->capabilities.valid)
+			continue;
+
+		const auto& info = channel->capabilities.info;
+		char buf[256] = { 0 };
+		snprintf(buf, sizeof(buf), "%s: %ux%u pixels, %zu bin factors, %zu readout modes, %.3f s minimum exposure in %.3f s steps",
+			channel->name, info.pixelsX, info.pixelsY, channel->capabilities.binList.size(), channel->capabilities.readoutModes.size(),
+			info.minExposureDuration, info.exposurePrecision);
+		Log(buf);
+	}
+}
+
+std::string AlumaX2::GetIniRoot(const int& nISIndex)
+{
+	//The first instance keeps the original section, so existing settings carry over
+	if (nISIndex == 0)
+		return KEY_ALUMAX2_ROOT;
+
+	return std::string(KEY_ALUMAX2_ROOT) + "_" + std::to_string(nISIndex);
+}
+
+void AlumaX2::SplitBinning(const int& bin, const unsigned int& maxHardwareBin, const bool& offChip, unsigned char& hardwareBin, unsigned char& softwareBin)
+{
+	//Use the largest hardware factor of the requested bin to keep the USB transfer small
+	auto hardware = 1;
+	if (!offChip)
+	{
+		for (auto candidate = std::min(bin, static_cast<int>(maxHardwareBin)); candidate > 1; --candidate)
+		{
+			if (bin % candidate == 0)
+			{
+				hardware = candidate;
+				break;
+			}
+		}
+	}
+
+	hardwareBin = static_cast<unsigned char>(hardware);
+	softwareBin = static_cast<unsigned char>(bin / hardware);
+}
+
+void AlumaX2::ReserveFrameArena()
+{
+	//Size every buffer for the largest full frame of any sensor with the current overscan setting
+	size_t framePixels = 0;
+	for (const auto channel : { &m_mainSensor, &m_externalSensor })
+	{
+		if (!channel->capabilities.valid)
+			continue;
+
+		const auto& sensorInfo = channel->capabilities.info;
+		framePixels = std::max<size_t>(framePixels, static_cast<size_t>(sensorInfo.pixelsX) * sensorInfo.pixelsY);
+	}
+
+	if (!m_frameArena.Reserve(FRAME_SCRATCH_BUFFERS, framePixels, GetLargePages() != 0))
+	{
+		Log("FrameArena: failed to reserve frame buffers");
+		return;
+	}
+
+	const auto stats = m_frameArena.GetStats();
+	char buf[256] = { 0 };
+	snprintf(buf, sizeof(buf), "FrameArena: reserved %zu buffers of %zu pixels (%.1f MB, large pages %s)",
+		stats.bufferCount, stats.bufferPixels, stats.regionBytes / 1048576.0, stats.largePages ? "on" : "off");
+	Log(buf);
+}
+
+void AlumaX2::LogFrameArenaStats() const
+{
+	const auto stats = m_frameArena.GetStats();
+	char buf[256] = { 0 };
+	snprintf(buf, sizeof(buf), "FrameArena: high-water mark %zu of %zu buffers, %zu acquisitions, %zu exhausted",
+		stats.highWaterMark, stats.bufferCount, stats.acquireCount, stats.exhaustedCount);
+	Log(buf);
+}
+
+void AlumaX2::ConfigureCalibrationLibrary()
+{
+	const auto budget = static_cast<size_t>(std::max(GetCalibrationBudget(), 0)) * 1024 * 1024;
+	m_calibrationLibrary.Configure(GetCalibrationDirectory(), budget);
+}
+
+void AlumaX2::LoadDefectMap()
+{
+	const auto directory = GetCalibrationDirectory();
+	m_defectMap.Load(directory.empty() ? std::string() : directory + "/" + CalibrationLibrary::GetSerialTag(m_cameraSerial) + ".defects");
+
+	char buf[128] = { 0 };
+	snprintf(buf, sizeof(buf), "DefectMap: loaded %zu defective pixels", m_defectMap.GetDefectCount());
+	Log(buf);
+}
+
+void AlumaX2::LogCalibrationStats() const
+{
+	const auto stats = m_calibrationLibrary.GetStats();
+	char buf[256] = { 0 };
+	snprintf(buf, sizeof(buf), "CalibrationLibrary: %zu masters mapped (%.1f of %.1f MB), %zu hits, %zu misses, %zu evictions",
+		stats.loadedMasters, stats.loadedBytes / 1048576.0, stats.budgetBytes / 1048576.0, stats.hits, stats.misses, stats.evictions);
+	Log(buf);
+}
+
+void AlumaX2::LogStatusPollerStats() const
+{
+	const auto stats = m_statusPoller.GetStats();
+	char buf[256] = { 0 };
+	snprintf(buf, sizeof(buf), "StatusPoller: %zu polls, %zu failed, %.2f ms average and %.2f ms worst query latency",
+		stats.polls, stats.failures, stats.averageLatencyMs, stats.maxLatencyMs);
+	Log(buf);
+}
+
+void AlumaX2::LogPromiseStats()
+{
+	const auto stats = m_promiseExecutor.GetStats();
+	m_promiseExecutor.ResetStats();
+
+	char buf[256] = { 0 };
+	snprintf(buf, sizeof(buf), "PromiseExecutor: at most %zu commands in flight", stats.maxInFlight);
+	Log(buf);
+
+	for (auto priority = 0; priority < PromiseExecutor::PriorityCount; ++priority)
+	{
+		const auto& classStats = stats.classes[priority];
+		if (classStats.completed + classStats.failed == 0)
+			continue;
+
+		snprintf(buf, sizeof(buf), "PromiseExecutor: %s %zu completed, %zu failed, %.2f ms average and %.2f ms worst queueing, %.2f ms average and %.2f ms worst latency",
+			PromiseExecutor::GetPriorityName(static_cast<PromiseExecutor::Priority>(priority)), classStats.completed, classStats.failed,
+			classStats.averageQueueMs, classStats.maxQueueMs, classStats.averageLatencyMs, classStats.maxLatencyMs);
+		Log(buf);
+	}
+}
+
+void AlumaX2::LogCameraShadowStats()
+{
+	const auto stats = m_cameraShadow.GetStats();
+	m_cameraShadow.ResetStats();
+
+	for (auto kind = 0; kind < CameraShadow::KindCount; ++kind)
+	{
+		if (stats[kind].hits + stats[kind].misses == 0)
+			continue;
+
+		char buf[256] = { 0 };
+		snprintf(buf, sizeof(buf), "CameraShadow: %s %zu commands skipped, %zu sent",
+			CameraShadow::GetKindName(static_cast<CameraShadow::Kind>(kind)), stats[kind].hits, stats[kind].misses);
+		Log(buf);
+	}
+}
+
+void AlumaX2::LogDownloadStats()
+{
+	for (const auto channel : { &m_mainSensor, &m_externalSensor })
+	{
+		const auto stats = channel->downloadWorker.GetStats();
+		channel->downloadWorker.ResetStats();
+
+		if (stats.downloads + stats.timeouts == 0)
+			continue;
+
+		char buf[256] = { 0 };
+		snprintf(buf, sizeof(buf), "%s: %zu downloads, %zu retries, %zu timeouts, %.1f MB/s average, %.1f MB/s last",
+			channel->name, stats.downloads, stats.retries, stats.timeouts,
+			stats.seconds > 0.0 ? stats.bytes / stats.seconds / 1048576.0 : 0.0, stats.lastThroughputMBps);
+		Log(buf);
+	}
+}
+
+void AlumaX2::LogReadoutStats()
+{
+	for (const auto channel : { &m_mainSensor, &m_externalSensor })
+	{
+		const auto stats = channel->readoutStats;
+		channel->readoutStats = SensorChannel::ReadoutStats{};
+
+		if (stats.readouts == 0)
+			continue;
+
+		char buf[256] = { 0 };
+		snprintf(buf, sizeof(buf), "%s: %zu readouts, %.3f ms average and %.3f ms worst copy (%.2f GB/s, %s, %u threads), %zu calibrated, %zu defects corrected",
+			channel->name, stats.readouts, stats.seconds / stats.readouts * 1e3, stats.maxSeconds * 1e3,
+			stats.seconds > 0.0 ? stats.bytes / stats.seconds / 1e9 : 0.0, ImageCopy::GetKernelName(ImageCopy::GetKernel()),
+			m_threadPool.GetThreadCount(), stats.calibratedFrames, stats.correctedDefects);
+		Log(buf);
+	}
+}
+
+void AlumaX2::LogGuidePortStats()
+{
+	const auto stats = m_guidePort.GetStats();
+	m_guidePort.ResetStats();
+
+	if (stats.pulses + stats.aborts == 0)
+		return;
+
+	char buf[256] = { 0 };
+	snprintf(buf, sizeof(buf), "Guide port: %zu pulses, %zu aborts, %zu failures, %zu timeouts",
+		stats.pulses, stats.aborts, stats.failures, stats.timeouts);
+	Log(buf);
+
+	//The occupied buckets of each histogram follow the summary
+	for (const auto& entry : { std::make_pair("command latency", &stats.commandLatency), std::make_pair("relay overrun", &stats.relayOverrun) })
+	{
+		const auto& histogram = *entry.second;
+		if (histogram.count == 0)
+			continue;
+
+		auto length = snprintf(buf, sizeof(buf), "Guide port %s: %zu samples, %.1f ms average, %.1f ms max,",
+			entry.first, histogram.count, histogram.averageMs, histogram.maxMs);
+		for (size_t bucket = 0; bucket < histogram.buckets.size() && length > 0 && static_cast<size_t>(length) < sizeof(buf); ++bucket)
+		{
+			if (histogram.buckets[bucket] != 0)
+				length += snprintf(buf + length, sizeof(buf) - length, " %.0f ms:%zu",
+					bucket * GuidePort::HISTOGRAM_BUCKET_MS, histogram.buckets[bucket]);
+		}
+		Log(buf);
+	}
+}
+
+int AlumaX2::PollFilterMove(bool& complete, const char* caller) const
+{
+	//Called with m_filterWheelLock held
+	std::string error;
+	if (!m_filterWheel.IsComplete(complete, error))
+	{
+		m_cameraShadow.ForgetFilterPosition();
+
+		char buf[256] = { 0 };
+		snprintf(buf, sizeof(buf), "%s: %s", caller, error.c_str());
+		Log(buf);
+
+		return ERR_CMDFAILED;
+	}
+
+	if (!complete)
+		return SB_OK;
+
+	//Unknown after an aborted move
+	const auto position = m_filterWheel.GetPosition();
+	if (position > 0)
+		m_cameraShadow.StoreFilterPosition(position);
+	else
+		m_cameraShadow.ForgetFilterPosition();
+
+	return SB_OK;
+}
+
+int AlumaX2::WaitForFilterMove()
+{
+	//The sensor lock is not held, so status polling and the external sensor carry on while the wheel turns
+	const auto deadline = std::chrono::steady_clock::now() + FILTER_MOVE_TIMEOUT;
+	while (true)
+	{
+		{
+			std::lock_guard<ContentionLock> filterWheelLock(m_filterWheelLock);
+
+			m_filterWheel.Release();
+
+			auto complete = false;
+			const auto result = PollFilterMove(complete, "CCStartExposure");
+			if (result != SB_OK || complete)
+				return result;
+		}
+
+		if (std::chrono::steady_clock::now() >= deadline)
+		{
+			Log("CCStartExposure: the filter wheel did not settle in time");
+			return ERR_COMMANDINPROGRESS;
+		}
+
+		m_sleeper->sleep(FILTER_MOVE_POLL_MS);
+	}
+}
+
+void AlumaX2::ReleaseFilterMove()
+{
+	std::lock_guard<ContentionLock> lock(m_filterWheelLock);
+	m_filterWheel.Release();
+}
+
+void AlumaX2::LogFilterWheelStats()
+{
+	const auto stats = m_filterWheel.GetStats();
+	m_filterWheel.ResetStats();
+
+	char buf[256] = { 0 };
+	snprintf(buf, sizeof(buf), "Filter wheel: %zu status queries, %zu polls answered from the move model, %zu aborts",
+		stats.statusQueries, stats.suppressedPolls, stats.aborts);
+	Log(buf);
+
+	//One line per slot distance, with the occupied buckets of the move time histogram
+	for (size_t distance = 1; distance < stats.distances.size(); ++distance)
+	{
+		const auto& moves = stats.distances[distance];
+		if (moves.moves == 0)
+			continue;
+
+		auto length = snprintf(buf, sizeof(buf), "Filter wheel distance %zu: %zu moves, %.2f s average, %.2f-%.2f s, %.2f s predicted,",
+			distance, moves.moves, moves.averageSeconds, moves.minSeconds, moves.maxSeconds, moves.predictedSeconds);
+		for (size_t bucket = 0; bucket < moves.histogram.size() && length > 0 && static_cast<size_t>(length) < sizeof(buf); ++bucket)
+		{
+			if (moves.histogram[bucket] != 0)
+				length += snprintf(buf + length, sizeof(buf) - length, " %.2f s:%zu",
+					bucket * FilterWheelController::HISTOGRAM_BUCKET_SECONDS, moves.histogram[bucket]);
+		}
+		Log(buf);
+	}
+}
+
+int AlumaX2::WaitForDownload(SensorChannel& channel)
+{
+	std::string error;
+	if (channel.downloadWorker.Wait(error))
+		return SB_OK;
+
+	Log(error.c_str());
+	return ERR_CMDFAILED;
+}
+
+void AlumaX2::Log(const char* message) const
+{
+	std::lock_guard<ContentionLock> lock(m_logLock);
+	m_logger->out(message);
+}
+
+void AlumaX2::LogLockStats()
+{
+	for (const auto lock : { &m_ioLock, &m_mainSensor.lock, &m_externalSensor.lock, &m_tecLock, &m_filterWheelLock, &m_settingsLock, &m_logLock })
+	{
+		const auto stats = lock->GetStats();
+		lock->ResetStats();
+
+		char buf[256] = { 0 };
+		snprintf(buf, sizeof(buf), "Locks: %s acquired %zu times, %zu contended, %.3f ms total and %.3f ms worst wait",
+			lock->GetName(), stats.acquisitions, stats.contended, stats.totalWaitMs, stats.maxWaitMs);
+		Log(buf);
+	}
+}
+
+unsigned int AlumaX2::ConvertCCDtoSensorId(const enumWhichCCD & CCD) const
+{
+	return GetFlipSensors() ? (CCD == enumWhichCCD::CCD_GUIDER ? 0 : 1) : (CCD == enumWhichCCD::CCD_IMAGER ? 0 : 1);
+}
+
+SensorChannel& AlumaX2::GetChannel(const enumWhichCCD& CCD)
+{
+	return ConvertCCDtoSensorId(CCD) == 0 ? m_mainSensor : m_externalSensor;
 }
@@ -3,9 +3,11 @@
 #include <stdio.h>
 
 #include <cameradriverinterface.h>
+#include <cameradependentsettinginterface.h>
 #include <subframeinterface.h>
 #include <filterwheelmovetointerface.h>
 #include <modalsettingsdialoginterface.h>
+#include <addfitskeyinterface.h>
 #include <x2guiinterface.h>
 #include <sleeperinterface.h>
 #include <basiciniutilinterface.h>
@@ -13,7 +15,28 @@
 
 #include <dlapi.h>
 
+#include "CalibrationLibrary.h"
+#include "CameraShadow.h"
+#include "ContentionLock.h"
+#include "DefectMap.h"
+#include "FilterWheelController.h"
+#include "FrameArena.h"
+#include "FrameStatistics.h"
+#include "GuidePort.h"
+#include "OverscanCorrection.h"
+#include "PromiseExecutor.h"
+#include "SensorChannel.h"
+#include "SoftwareBinning.h"
+#include "StatusPoller.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 
 class SerXInterface;
@@ -25,13 +48,14 @@ class MutexInterface;
 class TickCountInterface;
 
 
-class AlumaX2 : public CameraDriverInterface, public SubframeInterface, public FilterWheelMoveToInterface, public ModalSettingsDialogInterface, public X2GUIEventInterface
+class AlumaX2 : public CameraDriverInterface, public SubframeInterface, public FilterWheelMoveToInterface, public ModalSettingsDialogInterface, public X2GUIEventInterface, public AddFITSKeyInterface, public CameraDependentSettingInterface
 {
 
 public:
 	AlumaX2(AlumaX2 const&) = delete;
 	void operator=(AlumaX2 const&) = delete;
 
+	//One driver object per live TheSkyX instance index, a repeat call returns it and releases the interfaces it was passed
 	static AlumaX2* GetInstance(const int& nISIndex, TheSkyXFacadeForDriversInterface* pTheSkyXForMounts, SleeperInterface* pSleeper, BasicIniUtilInterface* pIniUtilIn, LoggerInterface* pLoggerIn, MutexInterface* pIOMutex);
 
 private:
@@ -101,15 +125,39 @@ public:
 	//X2GUIEventInterface
 	void uiEvent(X2GUIExchangeInterface* uiex, const char* pszEvent) override;
 
+	//AddFITSKeyInterface
+	int countOfIntegerFields(int& nCount) override;
+	int valueForIntegerField(int nIndex, BasicStringInterface& sFieldName, BasicStringInterface& sFieldComment, int& nFieldValue) override;
+	int countOfDoubleFields(int& nCount) override;
+	int valueForDoubleField(int nIndex, BasicStringInterface& sFieldName, BasicStringInterface& sFieldComment, double& dFieldValue) override;
+	int countOfStringFields(int& nCount) override;
+	int valueForStringField(int nIndex, BasicStringInterface& sFieldName, BasicStringInterface& sFieldComment, BasicStringInterface& sFieldValue) override;
+
+	//CameraDependentSettingInterface
+	int CCGetExtendedSettingName(const enumCameraIndex& Camera, const enumWhichCCD& CCDOrig, BasicStringInterface& sSettingName) override;
+	int CCGetExtendedValueCount(const enumCameraIndex& Camera, const enumWhichCCD& CCDOrig, int& nCount) override;
+	int CCGetExtendedValueName(const enumCameraIndex& Camera, const enumWhichCCD& CCDOrig, const int nIndex, BasicStringInterface& sName) override;
+	int CCStartExposureAdditionalArgInterface(const enumCameraIndex& Cam, const enumWhichCCD CCD, const double& dTime, enumPictureType Type,
+		const int& nABGState, const bool& bLeaveShutterAlone, const int& nIndex) override;
+
 
 private:
 	int m_isIndex;
+	//Settings section of this instance, so every instance remembers its own camera
+	const std::string m_iniRoot;
 	TheSkyXFacadeForDriversInterface* m_theSkyXFacade;
 	SleeperInterface* m_sleeper;
 	BasicIniUtilInterface* m_iniUtil;
 	LoggerInterface* m_logger;
 	MutexInterface* m_mutex;
 
+	//TheSkyX's mutex is only held while linking, everything else is serialized per subsystem
+	mutable ContentionLock m_ioLock;
+	mutable ContentionLock m_tecLock{ "TEC" };
+	mutable ContentionLock m_filterWheelLock{ "Filter wheel" };
+	mutable ContentionLock m_settingsLock{ "Settings" };
+	mutable ContentionLock m_logLock{ "Log" };
+
 	//Settings
 	//int m_autoFanMode;
 	//int m_useOverscan;
@@ -120,24 +168,154 @@ private:
 	int GetUseOverscan() const;
 	void SetUseOverscan(const int& useOverscan) const;
 
+	int GetLargePages() const;
+	void SetLargePages(const int& largePages) const;
+
+	int GetSoftwareBinAverage() const;
+	void SetSoftwareBinAverage(const int& softwareBinAverage) const;
+
+	int GetOverscanCorrection() const;
+	void SetOverscanCorrection(const int& overscanCorrection) const;
+
+	int GetApplyCalibration() const;
+	void SetApplyCalibration(const int& applyCalibration) const;
+
+	int GetRecordCalibration() const;
+	void SetRecordCalibration(const int& recordCalibration) const;
+
+	int GetCalibrationBudget() const;
+	void SetCalibrationBudget(const int& calibrationBudget) const;
+
+	int GetLearnDefects() const;
+	void SetLearnDefects(const int& learnDefects) const;
+
+	int GetCorrectDefects() const;
+	void SetCorrectDefects(const int& correctDefects) const;
+
+	int GetFrameStatistics() const;
+	void SetFrameStatistics(const int& frameStatistics) const;
+
+	int GetEarlyFilterMove() const;
+	void SetEarlyFilterMove(const int& earlyFilterMove) const;
+
+	int GetCameraSerialNumber() const;
+	void SetCameraSerialNumber(const int& cameraSerialNumber) const;
+
+	int GetCameraEndpoint() const;
+	void SetCameraEndpoint(const int& cameraEndpoint) const;
+
+	int GetConnectionMode() const;
+	void SetConnectionMode(const int& connectionMode) const;
+
+	std::string GetNetworkAddress() const;
+	void SetNetworkAddress(const std::string& networkAddress) const;
+
+	int GetNetworkPort() const;
+	void SetNetworkPort(const int& networkPort) const;
+
+	int GetDownloadTimeout() const;
+	void SetDownloadTimeout(const int& downloadTimeout) const;
+
+	int GetDownloadRetries() const;
+	void SetDownloadRetries(const int& downloadRetries) const;
+
+	std::string GetCalibrationDirectory() const;
+
+	int ReadIntSetting(const char* key, const int& defaultValue) const;
+	void WriteIntSetting(const char* key, const int& value) const;
+
 
 	std::shared_ptr<dl::IGateway> m_gateway;
 	dl::ICameraPtr m_cameraPtr;
 	dl::IFWPtr m_filterWheelPtr;
 
 	bool m_flipSensors{ false };
+	std::string m_cameraSerial;
+	//Serial number of the linked camera, 0 when unlinked, read by other instances to skip it in discovery
+	std::atomic<unsigned int> m_linkedSerialNumber{ 0 };
+	dl::EEndpointType m_cameraEndpoint{ dl::InvalidEndpoint };
+
+	//Serial numbers listed by the last network discovery in the settings dialog, in combo box order
+	std::vector<unsigned int> m_discoveredSerials;
+
+	struct OverscanGeometry
+	{
+		bool valid{ false };
+		unsigned int activeX{ 0 };
+		unsigned int activeY{ 0 };
+		unsigned int fullX{ 0 };
+		unsigned int fullY{ 0 };
+		unsigned int serialNumber{ 0 };
+	};
+	OverscanGeometry m_overscanGeometry;
+	//Kept over a reconnect, so a camera that still has its overscan enabled is not toggled again
+	OverscanGeometry m_measuredOverscan;
+
+	ThreadPool m_threadPool;
+	FrameArena m_frameArena;
+	CalibrationLibrary m_calibrationLibrary;
+	DefectMap m_defectMap;
+	//Every SDK command goes through the executor, declared before its users so it outlives them
+	mutable PromiseExecutor m_promiseExecutor;
+	StatusPoller m_statusPoller;
+	mutable CameraShadow m_cameraShadow;
+	mutable FilterWheelController m_filterWheel;
+	GuidePort m_guidePort;
+
+	//Held by a download worker for the whole transfer, the camera cannot download both sensors at once
+	std::mutex m_transportMutex;
+	SensorChannel m_mainSensor;
+	SensorChannel m_externalSensor;
+
+	static std::mutex s_instancesMutex;
+	static std::map<int, AlumaX2*> s_instances;
+	//The SDK gateway is a process wide singleton, so discovery and lookup in its device lists is serialized across instances
+	static std::mutex s_discoveryMutex;
 
-	unsigned char m_imagerBinX{ 1 };
-	unsigned char m_imagerBinY{ 1 };
-	unsigned char m_guiderBinX{ 1 };
-	unsigned char m_guiderBinY{ 1 };
-
-	MutexInterface* GetMutex() const { return m_mutex; };
 	bool GetFlipSensors() const { return m_flipSensors; };
 
+	dl::ICameraPtr ConnectCamera(const char*& path);
+	dl::ICameraPtr ConnectNetworkCamera(const unsigned int& serialNumber, const char*& path);
+	dl::ICameraPtr FindCamera(const unsigned int& serialNumber, const dl::EEndpointType& endpoint = dl::InvalidEndpoint) const;
+	dl::ICameraPtr FindUnclaimedCamera(const dl::EEndpointType& endpoint) const;
+	bool IsClaimedByOtherInstance(const unsigned int& serialNumber) const;
+	void ApplyDownloadPolicy();
+	void DiscoverNetworkCameras(X2GUIExchangeInterface* uiex);
 	int GetCameraStatus(dl::ICamera::Status& status) const;
-	int HandlePromise(const dl::IPromisePtr& promise) const;
-	static bool IsTransferCompleted(const dl::IPromisePtr& promise);
+	int GetStatusSnapshot(StatusPoller::Snapshot& snapshot) const;
+	int HandlePromise(const PromiseExecutor::Priority& priority, const PromiseExecutor::Issue& issue) const;
+	int WaitForPromise(const PromiseExecutor::Ticket& ticket) const;
+	int SetSensorSetting(const dl::ISensorPtr& sensor, const dl::ISensor::Setting& setting, const int& value);
+	void ReserveFrameArena();
+	void LogFrameArenaStats() const;
+	void ConfigureCalibrationLibrary();
+	void LoadDefectMap();
+	void LogCalibrationStats() const;
+	void LogStatusPollerStats() const;
+	void LogPromiseStats();
+	void LogCameraShadowStats();
+	void LogDownloadStats();
+	void LogReadoutStats();
+	void LogFilterWheelStats();
+	void LogGuidePortStats();
+	int PollFilterMove(bool& complete, const char* caller) const;
+	int WaitForFilterMove();
+	void ReleaseFilterMove();
+	void LogLockStats();
+	void Log(const char* message) const;
+	int StartExposure(const enumWhichCCD& CCD, const double& dTime, const enumPictureType& Type, const unsigned int& readoutMode);
+	int WaitForDownload(SensorChannel& channel);
+	int CopyImage(SensorChannel& channel, const unsigned short* source, const size_t& length, const dl::TImageMetadata& metadata,
+		const int& nWidth, const int& nHeight, const int& nMemWidth, unsigned char* pMem);
+	OverscanCorrection::Mode PlanOverscanCorrection(const unsigned int& sensorId, const dl::TImageMetadata& metadata,
+		unsigned int& frameWidth, unsigned int& frameHeight) const;
+	bool IsOverscanCorrected(const unsigned int& sensorId) const;
+	unsigned int GetOverscanColumns(const unsigned int& sensorId, const unsigned int& bin) const;
+	void ApplyOverscanSetting(const dl::ISensorPtr& sensor);
+	void RefreshCapabilities();
+	static std::string GetIniRoot(const int& nISIndex);
+	static void SplitBinning(const int& bin, const unsigned int& maxHardwareBin, const bool& offChip, unsigned char& hardwareBin, unsigned char& softwareBin);
 	unsigned int ConvertCCDtoSensorId(const enumWhichCCD& CCD) const;
+	SensorChannel& GetChannel(const enumWhichCCD& CCD);
 };
 
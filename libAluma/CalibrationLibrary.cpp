@@ -0,0 +1,290 @@
+#include "CalibrationLibrary.h"
+#include "SimdSupport.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+
+constexpr uint32_t MASTER_MAGIC = 0x4c414341;	//"ACAL"
+constexpr uint32_t MASTER_VERSION = 1;
+//Past this many frames a master keeps following slow drift as an exponential moving average
+constexpr uint32_t MAX_MASTER_FRAMES = 256;
+//Added back after subtraction so noise around the master level is not clipped at zero
+constexpr unsigned short CALIBRATION_PEDESTAL = 100;
+
+
+namespace
+{
+	struct MasterHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t frameCount;
+		uint32_t reserved[3];
+	};
+
+	size_t GetMasterBytes(const CalibrationLibrary::Key& key)
+	{
+		return sizeof(MasterHeader) + sizeof(unsigned short) * static_cast<size_t>(key.width) * key.height;
+	}
+
+	unsigned short* GetMasterPixels(const MappedFile& file)
+	{
+		return reinterpret_cast<unsigned short*>(file.GetData() + sizeof(MasterHeader));
+	}
+
+	//pixel + pedestal - master, saturating at 0 and 65535
+	void SubtractRowScalar(unsigned short* pixels, const unsigned short* master, const size_t& count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto raised = std::min(static_cast<unsigned int>(pixels[i]) + CALIBRATION_PEDESTAL, 65535u);
+			pixels[i] = static_cast<unsigned short>(raised > master[i] ? raised - master[i] : 0);
+		}
+	}
+
+#ifdef ALUMA_X86
+	void SubtractRowSSE2(unsigned short* pixels, const unsigned short* master, const size_t& count)
+	{
+		const auto pedestal = _mm_set1_epi16(static_cast<short>(CALIBRATION_PEDESTAL));
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const auto raised = _mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i)), pedestal);
+			const auto level = _mm_loadu_si128(reinterpret_cast<const __m128i*>(master + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_subs_epu16(raised, level));
+		}
+		SubtractRowScalar(pixels + i, master + i, count - i);
+	}
+
+	ALUMA_TARGET_AVX2 void SubtractRowAVX2(unsigned short* pixels, const unsigned short* master, const size_t& count)
+	{
+		const auto pedestal = _mm256_set1_epi16(static_cast<short>(CALIBRATION_PEDESTAL));
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			const auto raised = _mm256_adds_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i)), pedestal);
+			const auto level = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(master + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), _mm256_subs_epu16(raised, level));
+		}
+		SubtractRowScalar(pixels + i, master + i, count - i);
+	}
+#endif
+
+#ifdef ALUMA_NEON
+	void SubtractRowNEON(unsigned short* pixels, const unsigned short* master, const size_t& count)
+	{
+		const auto pedestal = vdupq_n_u16(CALIBRATION_PEDESTAL);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const auto raised = vqaddq_u16(vld1q_u16(pixels + i), pedestal);
+			vst1q_u16(pixels + i, vqsubq_u16(raised, vld1q_u16(master + i)));
+		}
+		SubtractRowScalar(pixels + i, master + i, count - i);
+	}
+#endif
+
+	void SubtractRows(unsigned short* pixels, const size_t& stride, const unsigned short* master, const size_t& width,
+		const size_t& rowBegin, const size_t& rowEnd)
+	{
+		const auto subtractRow = ALUMA_SELECT_KERNEL(SubtractRow);
+
+		for (auto row = rowBegin; row < rowEnd; ++row)
+			subtractRow(pixels + row * stride, master + row * width, width);
+	}
+}
+
+
+void CalibrationLibrary::Configure(const std::string& directory, const size_t& budgetBytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (directory != m_directory)
+	{
+		m_entries.clear();
+		m_lru.clear();
+		m_stats.loadedMasters = 0;
+		m_stats.loadedBytes = 0;
+	}
+
+	m_directory = directory;
+	m_budgetBytes = budgetBytes;
+	m_stats.budgetBytes = budgetBytes;
+	Evict(0);
+}
+
+CalibrationLibrary::Master CalibrationLibrary::Apply(ThreadPool& pool, const Key& key, unsigned short* pixels, const size_t& stride)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_directory.empty() || key.width == 0 || key.height == 0)
+		return None;
+
+	auto applied = Dark;
+	auto file = key.exposureMs > 0 ? Load(GetFileName(key, Dark), key, false) : nullptr;
+	if (file == nullptr)
+	{
+		applied = Bias;
+		file = Load(GetFileName(key, Bias), key, false);
+	}
+
+	if (file == nullptr)
+		return None;
+
+	const auto master = GetMasterPixels(*file);
+
+	if (!pool.ShouldSplit(sizeof(unsigned short) * key.width * key.height))
+	{
+		SubtractRows(pixels, stride, master, key.width, 0, key.height);
+		return applied;
+	}
+
+	pool.ParallelFor(key.height, [&](size_t begin, size_t end)
+	{
+		SubtractRows(pixels, stride, master, key.width, begin, end);
+	});
+
+	return applied;
+}
+
+unsigned int CalibrationLibrary::Record(const Key& key, const Master& master, const unsigned short* pixels, const size_t& stride)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_directory.empty() || master == None || key.width == 0 || key.height == 0)
+		return 0;
+
+	const auto file = Load(GetFileName(key, master), key, true);
+	if (file == nullptr)
+		return 0;
+
+	auto& header = *reinterpret_cast<MasterHeader*>(file->GetData());
+	const auto level = GetMasterPixels(*file);
+	const auto count = std::min(header.frameCount, MAX_MASTER_FRAMES - 1);
+
+	for (size_t row = 0; row < key.height; ++row)
+	{
+		const auto src = pixels + row * stride;
+		const auto dst = level + row * key.width;
+
+		if (count == 0)
+		{
+			std::copy(src, src + key.width, dst);
+			continue;
+		}
+
+		for (size_t i = 0; i < key.width; ++i)
+			dst[i] = static_cast<unsigned short>((static_cast<uint32_t>(dst[i]) * count + src[i] + (count + 1) / 2) / (count + 1));
+	}
+
+	header.frameCount = count + 1;
+
+	return header.frameCount;
+}
+
+void CalibrationLibrary::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_entries.clear();
+	m_lru.clear();
+	m_stats.loadedMasters = 0;
+	m_stats.loadedBytes = 0;
+}
+
+CalibrationLibrary::Stats CalibrationLibrary::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+MappedFile* CalibrationLibrary::Load(const std::string& fileName, const Key& key, const bool& create)
+{
+	const auto existing = m_entries.find(fileName);
+	if (existing != m_entries.end())
+	{
+		++m_stats.hits;
+		m_lru.splice(m_lru.begin(), m_lru, existing->second.lruPosition);
+		return existing->second.file.get();
+	}
+
+	++m_stats.misses;
+
+	const auto path = std::filesystem::u8path(m_directory) / fileName;
+	std::error_code error;
+	if (create)
+		std::filesystem::create_directories(path.parent_path(), error);
+	else if (!std::filesystem::exists(path, error))
+		return nullptr;
+
+	const auto bytes = GetMasterBytes(key);
+	Evict(bytes);
+
+	auto file = std::make_unique<MappedFile>();
+	if (!file->Open(path.u8string(), bytes, create))
+		return nullptr;
+
+	auto& header = *reinterpret_cast<MasterHeader*>(file->GetData());
+	if (header.magic != MASTER_MAGIC || header.version != MASTER_VERSION || header.width != key.width || header.height != key.height)
+	{
+		if (!create)
+			return nullptr;
+
+		header = MasterHeader{ MASTER_MAGIC, MASTER_VERSION, key.width, key.height, 0, {} };
+	}
+
+	m_lru.push_front(fileName);
+	auto& entry = m_entries[fileName];
+	entry.file = std::move(file);
+	entry.lruPosition = m_lru.begin();
+
+	++m_stats.loadedMasters;
+	m_stats.loadedBytes += bytes;
+
+	return entry.file.get();
+}
+
+void CalibrationLibrary::Evict(const size_t& incomingBytes)
+{
+	//A master larger than the whole budget is still loaded, it just displaces everything else
+	while (!m_lru.empty() && m_stats.loadedBytes + incomingBytes > m_budgetBytes)
+	{
+		const auto entry = m_entries.find(m_lru.back());
+		m_stats.loadedBytes -= entry->second.file->GetSize();
+		--m_stats.loadedMasters;
+		++m_stats.evictions;
+
+		m_entries.erase(entry);
+		m_lru.pop_back();
+	}
+}
+
+std::string CalibrationLibrary::GetSerialTag(const std::string& serial)
+{
+	std::string tag;
+	for (const auto c : serial)
+		tag += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+
+	return tag.empty() ? "unknown" : tag;
+}
+
+std::string CalibrationLibrary::GetFileName(const Key& key, const Master& master)
+{
+	char tec[32] = "toff";
+	if (key.tecEnabled)
+		snprintf(tec, sizeof(tec), "t%d", key.setpoint);
+
+	//Bias frames do not depend on the exposure time
+	char buf[256] = { 0 };
+	snprintf(buf, sizeof(buf), "%s_%s_b%ux%u_%u_%u_%ux%u_m%u_%s_e%u.cal",
+		GetSerialTag(key.serial).c_str(), master == Dark ? "dark" : "bias", key.binX, key.binY, key.offsetX, key.offsetY,
+		key.width, key.height, key.readoutMode, tec, master == Dark ? key.exposureMs : 0u);
+
+	return buf;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class ThreadPool;
+
+
+//Master bias and dark frames stored as memory mapped files, loaded on first use and evicted least recently used first
+class CalibrationLibrary
+{
+public:
+	enum Master
+	{
+		None,
+		Bias,
+		Dark
+	};
+
+	//Everything a master has to match for it to be subtracted from a frame
+	struct Key
+	{
+		std::string serial;
+		unsigned int binX{ 1 };
+		unsigned int binY{ 1 };
+		unsigned int offsetX{ 0 };
+		unsigned int offsetY{ 0 };
+		unsigned int width{ 0 };
+		unsigned int height{ 0 };
+		unsigned int readoutMode{ 0 };
+		unsigned int exposureMs{ 0 };
+		bool tecEnabled{ false };
+		int setpoint{ 0 };
+	};
+
+	struct Stats
+	{
+		size_t loadedMasters{ 0 };
+		size_t loadedBytes{ 0 };
+		size_t budgetBytes{ 0 };
+		size_t hits{ 0 };
+		size_t misses{ 0 };
+		size_t evictions{ 0 };
+	};
+
+	CalibrationLibrary() = default;
+
+	CalibrationLibrary(CalibrationLibrary const&) = delete;
+	void operator=(CalibrationLibrary const&) = delete;
+
+	void Configure(const std::string& directory, const size_t& budgetBytes);
+
+	//Subtracts the dark matching key, or the matching bias when there is no such dark, strides are in pixels
+	Master Apply(ThreadPool& pool, const Key& key, unsigned short* pixels, const size_t& stride);
+	//Folds the frame into the running mean of its master, returns the number of frames the master now holds
+	unsigned int Record(const Key& key, const Master& master, const unsigned short* pixels, const size_t& stride);
+
+	void Clear();
+	Stats GetStats() const;
+
+	//Serial number reduced to characters that are safe in a file name
+	static std::string GetSerialTag(const std::string& serial);
+
+private:
+	struct Entry
+	{
+		std::unique_ptr<MappedFile> file;
+		std::list<std::string>::iterator lruPosition;
+	};
+
+	std::string m_directory;
+	size_t m_budgetBytes{ 0 };
+	std::unordered_map<std::string, Entry> m_entries;
+	std::list<std::string> m_lru;
+	Stats m_stats;
+	mutable std::mutex m_mutex;
+
+	MappedFile* Load(const std::string& fileName, const Key& key, const bool& create);
+	void Evict(const size_t& incomingBytes);
+	static std::string GetFileName(const Key& key, const Master& master);
+};
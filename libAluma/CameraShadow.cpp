@@ -0,0 +1,180 @@
+#include "CameraShadow.h"
+
+#include <algorithm>
+
+
+const char* CameraShadow::GetKindName(const Kind& kind)
+{
+	switch (kind)
+	{
+	case Subframe:			return "subframe";
+	case Setting:			return "sensor setting";
+	case Tec:				return "TEC";
+	case FilterPosition:	return "filter position";
+	default:				return "unknown";
+	}
+}
+
+void CameraShadow::Load(const dl::ICameraPtr& camera)
+{
+	Clear();
+
+	if (camera == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const auto sensorCount = std::min<unsigned int>(camera->getInfo().numberOfSensors, MAX_SENSORS);
+	for (unsigned int id = 0; id < sensorCount; ++id)
+	{
+		const auto sensor = camera->getSensor(id);
+		if (sensor == nullptr)
+			continue;
+
+		auto& state = m_sensors[id];
+		state.subframe = { true, sensor->getSubframe() };
+
+		const auto settings = sensor->getSettings();
+		state.settings[dl::ISensor::UseOverscan] = { true, settings.useOverscan ? 1 : 0 };
+		state.settings[dl::ISensor::RBIPreflashDuration] = { true, settings.rbiPreflash.duration };
+		state.settings[dl::ISensor::RBIPreflashFlushCount] = { true, settings.rbiPreflash.flushes };
+		state.settings[dl::ISensor::UseWindowHeater] = { true, settings.useWindowHeater ? 1 : 0 };
+		state.settings[dl::ISensor::FanSpeed] = { true, settings.fanSpeed };
+		state.settings[dl::ISensor::ToggleIRLEDs] = { true, settings.enableIRLEDs ? 1 : 0 };
+		state.settings[dl::ISensor::UseOnChipBinning] = { true, settings.useOnChipBinning ? 1 : 0 };
+		state.settings[dl::ISensor::UseExtTrigger] = { true, settings.useExtTrigger ? 1 : 0 };
+		state.settings[dl::ISensor::AutoFanMode] = { true, settings.autoFanSpeed ? 1 : 0 };
+	}
+
+	const auto tec = camera->getTEC();
+	if (tec != nullptr)
+	{
+		m_tecEnabled = { true, tec->getEnabled() };
+		m_tecSetpoint = { true, tec->getSetpoint() };
+	}
+
+	//The wheel may still be homing after initialization, so its position is only trusted once the driver has set it
+}
+
+void CameraShadow::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_sensors = {};
+	m_tecEnabled = {};
+	m_tecSetpoint = {};
+	m_filterPosition = {};
+}
+
+bool CameraShadow::NeedsSubframe(const unsigned int& sensorId, const dl::TSubframe& subframe)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (sensorId >= MAX_SENSORS)
+		return Count(Subframe, false);
+
+	const auto& current = m_sensors[sensorId].subframe;
+	return Count(Subframe, current.known && IsSame(current.value, subframe));
+}
+
+void CameraShadow::StoreSubframe(const unsigned int& sensorId, const dl::TSubframe& subframe)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (sensorId < MAX_SENSORS)
+		m_sensors[sensorId].subframe = { true, subframe };
+}
+
+void CameraShadow::ForgetSubframe(const unsigned int& sensorId)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (sensorId < MAX_SENSORS)
+		m_sensors[sensorId].subframe = {};
+}
+
+bool CameraShadow::NeedsSetting(const unsigned int& sensorId, const dl::ISensor::Setting& setting, const int& value)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (sensorId >= MAX_SENSORS || setting >= dl::ISensor::SettingCount)
+		return Count(Setting, false);
+
+	const auto& current = m_sensors[sensorId].settings[setting];
+	return Count(Setting, current.known && current.value == value);
+}
+
+void CameraShadow::StoreSetting(const unsigned int& sensorId, const dl::ISensor::Setting& setting, const int& value)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (sensorId >= MAX_SENSORS || setting >= dl::ISensor::SettingCount)
+		return;
+
+	auto& state = m_sensors[sensorId];
+	const auto changed = !state.settings[setting].known || state.settings[setting].value != value;
+	state.settings[setting] = { true, value };
+
+	//Toggling the overscan changes the sensor geometry, the camera side subframe can no longer be trusted
+	if (setting == dl::ISensor::UseOverscan && changed)
+		state.subframe = {};
+}
+
+bool CameraShadow::NeedsTecState(const bool& enabled, const float& setpoint)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//The setpoint does not matter while the TEC stays off
+	const auto current = m_tecEnabled.known && m_tecEnabled.value == enabled
+		&& (!enabled || (m_tecSetpoint.known && m_tecSetpoint.value == setpoint));
+	return Count(Tec, current);
+}
+
+void CameraShadow::StoreTecState(const bool& enabled, const float& setpoint)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_tecEnabled = { true, enabled };
+	m_tecSetpoint = { true, setpoint };
+}
+
+bool CameraShadow::NeedsFilterPosition(const int& position)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return Count(FilterPosition, m_filterPosition.known && m_filterPosition.value == position);
+}
+
+void CameraShadow::StoreFilterPosition(const int& position)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_filterPosition = { true, position };
+}
+
+void CameraShadow::ForgetFilterPosition()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_filterPosition = {};
+}
+
+CameraShadow::Stats CameraShadow::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void CameraShadow::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats = Stats{};
+}
+
+bool CameraShadow::Count(const Kind& kind, const bool& current)
+{
+	++(current ? m_stats[kind].hits : m_stats[kind].misses);
+	return !current;
+}
+
+bool CameraShadow::IsSame(const dl::TSubframe& a, const dl::TSubframe& b)
+{
+	return a.top == b.top && a.left == b.left && a.width == b.width && a.height == b.height && a.binX == b.binX && a.binY == b.binY;
+}
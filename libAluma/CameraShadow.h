@@ -0,0 +1,82 @@
+#pragma once
+
+#include <dlapi.h>
+
+#include <array>
+#include <mutex>
+
+
+//Last known camera side state, commands that would not change it are not sent
+//Each Needs* call counts a hit when the camera already has the value and a miss when the command has to go out,
+//the matching Store* records the value once the command has succeeded
+class CameraShadow
+{
+public:
+	enum Kind
+	{
+		Subframe,
+		Setting,
+		Tec,
+		FilterPosition,
+		KindCount
+	};
+
+	struct Counter
+	{
+		size_t hits{ 0 };
+		size_t misses{ 0 };
+	};
+
+	using Stats = std::array<Counter, KindCount>;
+
+	static const char* GetKindName(const Kind& kind);
+
+	//Seeds the shadow from the state the SDK read from the camera when it was initialized
+	void Load(const dl::ICameraPtr& camera);
+	void Clear();
+
+	bool NeedsSubframe(const unsigned int& sensorId, const dl::TSubframe& subframe);
+	void StoreSubframe(const unsigned int& sensorId, const dl::TSubframe& subframe);
+	//Toggling the overscan moves the subframe origin, so the subframe has to be sent again
+	void ForgetSubframe(const unsigned int& sensorId);
+
+	bool NeedsSetting(const unsigned int& sensorId, const dl::ISensor::Setting& setting, const int& value);
+	void StoreSetting(const unsigned int& sensorId, const dl::ISensor::Setting& setting, const int& value);
+
+	bool NeedsTecState(const bool& enabled, const float& setpoint);
+	void StoreTecState(const bool& enabled, const float& setpoint);
+
+	bool NeedsFilterPosition(const int& position);
+	void StoreFilterPosition(const int& position);
+	//Where the wheel is after an aborted or failed move is not known
+	void ForgetFilterPosition();
+
+	Stats GetStats() const;
+	void ResetStats();
+
+private:
+	static constexpr unsigned int MAX_SENSORS = 2;
+
+	template <typename T>
+	struct Value
+	{
+		bool known{ false };
+		T value{};
+	};
+
+	struct SensorState
+	{
+		Value<dl::TSubframe> subframe;
+		std::array<Value<int>, dl::ISensor::SettingCount> settings;
+	};
+
+	bool Count(const Kind& kind, const bool& current);
+	static bool IsSame(const dl::TSubframe& a, const dl::TSubframe& b);
+
+	mutable std::mutex m_mutex;
+	std::array<SensorState, MAX_SENSORS> m_sensors;
+	Value<bool> m_tecEnabled;
+	Value<float> m_tecSetpoint;
+	Value<int> m_filterPosition;
+	Stats m_stats;
+};
@@ -0,0 +1,72 @@
+#include "ContentionLock.h"
+
+#include <mutexinterface.h>
+
+#include <chrono>
+
+//Waits on the external mutex below this are taken as uncontended, they are the cost of the lock call itself
+constexpr long long EXTERNAL_CONTENDED_NS = 10000;
+
+
+ContentionLock::ContentionLock(const char* name, MutexInterface* external) :
+	m_name(name),
+	m_external(external)
+{
+}
+
+void ContentionLock::lock()
+{
+	if (m_external == nullptr && m_mutex.try_lock())
+	{
+		Record(0);
+		return;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	if (m_external != nullptr)
+		m_external->lock();
+	else
+		m_mutex.lock();
+
+	Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+void ContentionLock::unlock()
+{
+	if (m_external != nullptr)
+		m_external->unlock();
+	else
+		m_mutex.unlock();
+}
+
+ContentionLock::Stats ContentionLock::GetStats() const
+{
+	Stats stats;
+	stats.acquisitions = m_acquisitions.load(std::memory_order_relaxed);
+	stats.contended = m_contended.load(std::memory_order_relaxed);
+	stats.totalWaitMs = m_totalWaitNs.load(std::memory_order_relaxed) / 1e6;
+	stats.maxWaitMs = m_maxWaitNs.load(std::memory_order_relaxed) / 1e6;
+	return stats;
+}
+
+void ContentionLock::ResetStats()
+{
+	m_acquisitions = 0;
+	m_contended = 0;
+	m_totalWaitNs = 0;
+	m_maxWaitNs = 0;
+}
+
+void ContentionLock::Record(const long long& waitNs)
+{
+	//Called with the lock held, so the maximum only races with ResetStats
+	m_acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+	if (waitNs == 0 || (m_external != nullptr && waitNs < EXTERNAL_CONTENDED_NS))
+		return;
+
+	m_contended.fetch_add(1, std::memory_order_relaxed);
+	m_totalWaitNs.fetch_add(waitNs, std::memory_order_relaxed);
+	if (waitNs > m_maxWaitNs.load(std::memory_order_relaxed))
+		m_maxWaitNs.store(waitNs, std::memory_order_relaxed);
+}
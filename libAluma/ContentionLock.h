@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+class MutexInterface;
+
+
+//Lockable that counts how often and for how long callers had to wait for it, usable with std::lock_guard
+class ContentionLock
+{
+public:
+	struct Stats
+	{
+		size_t acquisitions{ 0 };
+		size_t contended{ 0 };
+		double totalWaitMs{ 0.0 };
+		double maxWaitMs{ 0.0 };
+	};
+
+	//With an external mutex, which has no try_lock, waits longer than a few microseconds count as contended
+	explicit ContentionLock(const char* name, MutexInterface* external = nullptr);
+
+	ContentionLock(ContentionLock const&) = delete;
+	void operator=(ContentionLock const&) = delete;
+
+	void lock();
+	void unlock();
+
+	const char* GetName() const { return m_name; }
+	Stats GetStats() const;
+	void ResetStats();
+
+private:
+	void Record(const long long& waitNs);
+
+	const char* m_name;
+	MutexInterface* m_external;
+	std::mutex m_mutex;
+
+	std::atomic<size_t> m_acquisitions{ 0 };
+	std::atomic<size_t> m_contended{ 0 };
+	std::atomic<long long> m_totalWaitNs{ 0 };
+	std::atomic<long long> m_maxWaitNs{ 0 };
+};
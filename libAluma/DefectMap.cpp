@@ -0,0 +1,332 @@
+#include "DefectMap.h"
+#include "SimdSupport.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+constexpr uint32_t DEFECT_MAGIC = 0x46454441;	//"ADEF"
+constexpr uint32_t DEFECT_VERSION = 1;
+//Distance from the frame median, in robust standard deviations, beyond which a pixel is an outlier
+constexpr double DEFECT_SIGMA = 10.0;
+//Lower bound on that distance so very clean bias frames do not flag ordinary pixels
+constexpr unsigned int DEFECT_MIN_ADU = 100;
+//Frames with more outliers than this are rejected as light leaks or bad exposures
+constexpr size_t MAX_DEFECT_FRACTION = 200;
+//A pixel has to be an outlier in most of this many frames before it is mapped, which rejects cosmic rays
+constexpr uint32_t MIN_LEARN_FRAMES = 5;
+//Hit counts are halved past this many frames so the map follows pixels that come and go
+constexpr uint32_t MAX_LEARN_FRAMES = 64;
+
+
+namespace
+{
+	struct DefectHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t count;
+		uint32_t reserved;
+	};
+
+	uint32_t Pack(const uint32_t& x, const uint32_t& y)
+	{
+		return y << 16 | x;
+	}
+
+	//Appends the packed position of every pixel below low or above high
+	void ScanRowScalar(const unsigned short* row, const size_t& count, const unsigned short& low, const unsigned short& high,
+		const uint32_t& x0, const uint32_t& y, std::vector<uint32_t>& outliers)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (row[i] < low || row[i] > high)
+				outliers.push_back(Pack(x0 + static_cast<uint32_t>(i), y));
+		}
+	}
+
+	//The vector kernels only drop to scalar code for blocks that hold an outlier
+#ifdef ALUMA_X86
+	void ScanRowSSE2(const unsigned short* row, const size_t& count, const unsigned short& low, const unsigned short& high,
+		const uint32_t& x0, const uint32_t& y, std::vector<uint32_t>& outliers)
+	{
+		const auto lowValue = _mm_set1_epi16(static_cast<short>(low));
+		const auto highValue = _mm_set1_epi16(static_cast<short>(high));
+		const auto zero = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+			const auto outside = _mm_or_si128(_mm_subs_epu16(pixels, highValue), _mm_subs_epu16(lowValue, pixels));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(outside, zero)) != 0xffff)
+				ScanRowScalar(row + i, 8, low, high, x0 + static_cast<uint32_t>(i), y, outliers);
+		}
+		ScanRowScalar(row + i, count - i, low, high, x0 + static_cast<uint32_t>(i), y, outliers);
+	}
+
+	ALUMA_TARGET_AVX2 void ScanRowAVX2(const unsigned short* row, const size_t& count, const unsigned short& low, const unsigned short& high,
+		const uint32_t& x0, const uint32_t& y, std::vector<uint32_t>& outliers)
+	{
+		const auto lowValue = _mm256_set1_epi16(static_cast<short>(low));
+		const auto highValue = _mm256_set1_epi16(static_cast<short>(high));
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			const auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+			const auto outside = _mm256_or_si256(_mm256_subs_epu16(pixels, highValue), _mm256_subs_epu16(lowValue, pixels));
+			if (!_mm256_testz_si256(outside, outside))
+				ScanRowScalar(row + i, 16, low, high, x0 + static_cast<uint32_t>(i), y, outliers);
+		}
+		ScanRowScalar(row + i, count - i, low, high, x0 + static_cast<uint32_t>(i), y, outliers);
+	}
+#endif
+
+#ifdef ALUMA_NEON
+	void ScanRowNEON(const unsigned short* row, const size_t& count, const unsigned short& low, const unsigned short& high,
+		const uint32_t& x0, const uint32_t& y, std::vector<uint32_t>& outliers)
+	{
+		const auto lowValue = vdupq_n_u16(low);
+		const auto highValue = vdupq_n_u16(high);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const auto pixels = vld1q_u16(row + i);
+			const auto outside = vorrq_u16(vqsubq_u16(pixels, highValue), vqsubq_u16(lowValue, pixels));
+			if (vget_lane_u64(vreinterpret_u64_u16(vorr_u16(vget_low_u16(outside), vget_high_u16(outside))), 0) != 0)
+				ScanRowScalar(row + i, 8, low, high, x0 + static_cast<uint32_t>(i), y, outliers);
+		}
+		ScanRowScalar(row + i, count - i, low, high, x0 + static_cast<uint32_t>(i), y, outliers);
+	}
+#endif
+
+	unsigned int HistogramMedian(const std::vector<size_t>& histogram, const size_t& total)
+	{
+		const auto half = (total + 1) / 2;
+		size_t seen = 0;
+		for (size_t value = 0; value < histogram.size(); ++value)
+		{
+			seen += histogram[value];
+			if (seen >= half)
+				return static_cast<unsigned int>(value);
+		}
+
+		return 0;
+	}
+}
+
+
+bool DefectMap::Geometry::operator==(const Geometry& other) const
+{
+	return binX == other.binX && binY == other.binY && offsetX == other.offsetX && offsetY == other.offsetY
+		&& width == other.width && height == other.height;
+}
+
+void DefectMap::Load(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_path = path;
+	m_defects.clear();
+	m_hits.clear();
+	m_learnFrames = 0;
+	m_learnGeometry = Geometry{};
+	m_frameGeometry = Geometry{};
+	m_frameDefects.clear();
+
+	if (m_path.empty())
+		return;
+
+	std::ifstream file(std::filesystem::u8path(m_path), std::ios::binary);
+	DefectHeader header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != DEFECT_MAGIC || header.version != DEFECT_VERSION)
+		return;
+
+	m_defects.resize(header.count);
+	if (!file.read(reinterpret_cast<char*>(m_defects.data()), sizeof(uint32_t) * m_defects.size()))
+		m_defects.clear();
+}
+
+bool DefectMap::Learn(const unsigned short* pixels, const size_t& stride, const Geometry& geometry)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//Binned frames cannot place a defect on a single sensor pixel
+	if (geometry.binX != 1 || geometry.binY != 1 || geometry.width == 0 || geometry.height == 0
+		|| geometry.offsetX + geometry.width > 65536 || geometry.offsetY + geometry.height > 65536)
+		return false;
+
+	if (!(geometry == m_learnGeometry))
+	{
+		m_hits.clear();
+		m_learnFrames = 0;
+		m_learnGeometry = geometry;
+	}
+
+	//Robust level and spread of the frame from its histogram, so a few hot pixels do not skew them
+	thread_local std::vector<size_t> histogram;
+	histogram.assign(65536, 0);
+	for (size_t row = 0; row < geometry.height; ++row)
+	{
+		const auto src = pixels + row * stride;
+		for (size_t i = 0; i < geometry.width; ++i)
+			++histogram[src[i]];
+	}
+
+	const auto total = static_cast<size_t>(geometry.width) * geometry.height;
+	const auto median = HistogramMedian(histogram, total);
+
+	thread_local std::vector<size_t> deviations;
+	deviations.assign(65536, 0);
+	for (size_t value = 0; value < histogram.size(); ++value)
+		deviations[value > median ? value - median : median - value] += histogram[value];
+
+	const auto sigma = 1.4826 * HistogramMedian(deviations, total);
+	const auto spread = std::max(static_cast<unsigned int>(DEFECT_SIGMA * sigma), DEFECT_MIN_ADU);
+	const auto high = static_cast<unsigned short>(std::min(median + spread, 65535u));
+	const auto low = static_cast<unsigned short>(median > spread ? median - spread : 0);
+
+	const auto scanRow = ALUMA_SELECT_KERNEL(ScanRow);
+	std::vector<uint32_t> outliers;
+	for (size_t row = 0; row < geometry.height; ++row)
+	{
+		scanRow(pixels + row * stride, geometry.width, low, high, geometry.offsetX, geometry.offsetY + static_cast<uint32_t>(row), outliers);
+		if (outliers.size() > total / MAX_DEFECT_FRACTION)
+			return false;
+	}
+
+	for (const auto position : outliers)
+		++m_hits[position];
+
+	if (++m_learnFrames > MAX_LEARN_FRAMES)
+	{
+		m_learnFrames /= 2;
+		for (auto hit = m_hits.begin(); hit != m_hits.end();)
+		{
+			hit->second /= 2;
+			hit = hit->second == 0 ? m_hits.erase(hit) : std::next(hit);
+		}
+	}
+
+	if (m_learnFrames < MIN_LEARN_FRAMES)
+		return false;
+
+	//Defects outside the learned region are kept, those inside are replaced by what the frames agree on
+	std::vector<uint32_t> defects;
+	for (const auto position : m_defects)
+	{
+		const auto x = position & 0xffff;
+		const auto y = position >> 16;
+		if (x < geometry.offsetX || x >= geometry.offsetX + geometry.width || y < geometry.offsetY || y >= geometry.offsetY + geometry.height)
+			defects.push_back(position);
+	}
+
+	for (const auto& hit : m_hits)
+	{
+		if (hit.second * 2 > m_learnFrames)
+			defects.push_back(hit.first);
+	}
+
+	std::sort(defects.begin(), defects.end());
+	if (defects == m_defects)
+		return false;
+
+	m_defects.swap(defects);
+	m_frameGeometry = Geometry{};
+	Save();
+
+	return true;
+}
+
+size_t DefectMap::Correct(unsigned short* pixels, const size_t& stride, const Geometry& geometry)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_defects.empty() || geometry.width == 0 || geometry.height == 0)
+		return 0;
+
+	if (!(geometry == m_frameGeometry))
+		MapToFrame(geometry);
+
+	//Only the defects are touched, neighbours that are defects themselves are left out of the median
+	for (const auto position : m_frameDefects)
+	{
+		const auto x = static_cast<int>(position & 0xffff);
+		const auto y = static_cast<int>(position >> 16);
+
+		unsigned short good[8];
+		unsigned short all[8];
+		size_t goodCount = 0;
+		size_t allCount = 0;
+
+		for (auto dy = -1; dy <= 1; ++dy)
+		{
+			for (auto dx = -1; dx <= 1; ++dx)
+			{
+				const auto nx = x + dx;
+				const auto ny = y + dy;
+				if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= static_cast<int>(geometry.width) || ny >= static_cast<int>(geometry.height))
+					continue;
+
+				const auto value = pixels[ny * stride + nx];
+				all[allCount++] = value;
+				if (!std::binary_search(m_frameDefects.begin(), m_frameDefects.end(), Pack(nx, ny)))
+					good[goodCount++] = value;
+			}
+		}
+
+		const auto samples = goodCount > 0 ? good : all;
+		const auto count = goodCount > 0 ? goodCount : allCount;
+		if (count == 0)
+			continue;
+
+		std::nth_element(samples, samples + count / 2, samples + count);
+		pixels[y * stride + x] = samples[count / 2];
+	}
+
+	return m_frameDefects.size();
+}
+
+size_t DefectMap::GetDefectCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_defects.size();
+}
+
+bool DefectMap::Save() const
+{
+	if (m_path.empty())
+		return false;
+
+	const auto path = std::filesystem::u8path(m_path);
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	const DefectHeader header{ DEFECT_MAGIC, DEFECT_VERSION, static_cast<uint32_t>(m_defects.size()), 0 };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_defects.data()), sizeof(uint32_t) * m_defects.size());
+
+	return static_cast<bool>(file);
+}
+
+void DefectMap::MapToFrame(const Geometry& geometry)
+{
+	//A binned pixel is defective when any of the sensor pixels it sums is
+	const auto binX = std::max(geometry.binX, 1u);
+	const auto binY = std::max(geometry.binY, 1u);
+
+	m_frameDefects.clear();
+	for (const auto position : m_defects)
+	{
+		const auto x = (position & 0xffff) / binX;
+		const auto y = (position >> 16) / binY;
+		if (x < geometry.offsetX || y < geometry.offsetY || x - geometry.offsetX >= geometry.width || y - geometry.offsetY >= geometry.height)
+			continue;
+
+		m_frameDefects.push_back(Pack(x - geometry.offsetX, y - geometry.offsetY));
+	}
+
+	std::sort(m_frameDefects.begin(), m_frameDefects.end());
+	m_frameDefects.erase(std::unique(m_frameDefects.begin(), m_frameDefects.end()), m_frameDefects.end());
+	m_frameGeometry = geometry;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+//Hot and cold pixels of one camera, learned from dark and bias frames and replaced by the median of their neighbours
+class DefectMap
+{
+public:
+	//Placement of a frame on the sensor, offsets are in binned pixels
+	struct Geometry
+	{
+		unsigned int binX{ 1 };
+		unsigned int binY{ 1 };
+		unsigned int offsetX{ 0 };
+		unsigned int offsetY{ 0 };
+		unsigned int width{ 0 };
+		unsigned int height{ 0 };
+
+		bool operator==(const Geometry& other) const;
+	};
+
+	DefectMap() = default;
+
+	DefectMap(DefectMap const&) = delete;
+	void operator=(DefectMap const&) = delete;
+
+	//Loads the stored map and restarts learning, an empty path disables persistence
+	void Load(const std::string& path);
+
+	//Flags outliers of an unbinned dark or bias frame, returns true when the map changed, strides are in pixels
+	bool Learn(const unsigned short* pixels, const size_t& stride, const Geometry& geometry);
+	//Replaces every defect inside the frame, returns the number of replaced pixels
+	size_t Correct(unsigned short* pixels, const size_t& stride, const Geometry& geometry);
+
+	size_t GetDefectCount() const;
+
+private:
+	std::string m_path;
+	//Sensor positions packed as y << 16 | x, sorted
+	std::vector<uint32_t> m_defects;
+	std::unordered_map<uint32_t, uint32_t> m_hits;
+	uint32_t m_learnFrames{ 0 };
+	Geometry m_learnGeometry;
+
+	//m_defects translated to the last corrected frame geometry
+	Geometry m_frameGeometry;
+	std::vector<uint32_t> m_frameDefects;
+
+	mutable std::mutex m_mutex;
+
+	bool Save() const;
+	void MapToFrame(const Geometry& geometry);
+};
@@ -0,0 +1,167 @@
+#include "DownloadWorker.h"
+
+#include <algorithm>
+
+
+DownloadWorker::DownloadWorker(std::mutex& transportMutex, PromiseExecutor& executor) :
+	m_transportMutex(transportMutex),
+	m_executor(executor),
+	m_thread(&DownloadWorker::Run, this)
+{
+}
+
+DownloadWorker::~DownloadWorker()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_requestEvent.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+bool DownloadWorker::Start(const dl::ISensorPtr& sensor)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_busy || sensor == nullptr)
+			return false;
+
+		m_busy = true;
+		m_succeeded = true;
+		m_lastError.clear();
+		m_pendingSensor = sensor;
+	}
+	m_requestEvent.notify_one();
+
+	return true;
+}
+
+bool DownloadWorker::Wait(std::string& error)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_completeEvent.wait(lock, [this] { return !m_busy; });
+
+	error = m_lastError;
+	return m_succeeded;
+}
+
+bool DownloadWorker::IsBusy() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_busy;
+}
+
+void DownloadWorker::SetPolicy(const Policy& policy)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_policy = policy;
+	m_policy.attempts = std::max(m_policy.attempts, 1u);
+}
+
+DownloadWorker::Stats DownloadWorker::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void DownloadWorker::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats = Stats{};
+}
+
+void DownloadWorker::Run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_requestEvent.wait(lock, [this] { return m_stopping || m_pendingSensor != nullptr; });
+
+		if (m_stopping)
+			return;
+
+		const auto sensor = m_pendingSensor;
+		const auto policy = m_policy;
+		m_pendingSensor = nullptr;
+		lock.unlock();
+
+		Download(sensor, policy);
+		lock.lock();
+	}
+}
+
+void DownloadWorker::Download(const dl::ISensorPtr& sensor, const Policy& policy)
+{
+	//The transfer is scheduled behind guiding and exposure commands, the worker blocks until it has completed
+	std::lock_guard<std::mutex> transportLock(m_transportMutex);
+
+	const auto start = std::chrono::steady_clock::now();
+	const auto deadline = start + policy.timeout;
+	const auto isTransferDone = [this] { return m_transferDone; };
+	auto succeeded = false;
+	auto timedOut = false;
+	unsigned int attempt = 0;
+	std::string error;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	//A failed transfer is asked for again, a timed out one is still owned by the SDK and ends the download
+	while (!succeeded && !timedOut && attempt < policy.attempts)
+	{
+		m_transferDone = false;
+		m_executor.Submit(PromiseExecutor::Download, [sensor] { return sensor->startDownload(); },
+			[this](const bool& transferSucceeded, const std::string& transferError)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_transferDone = true;
+				m_transferSucceeded = transferSucceeded;
+				m_transferError = transferError;
+				m_transferEvent.notify_all();
+			});
+		++attempt;
+
+		if (policy.timeout.count() <= 0)
+			m_transferEvent.wait(lock, isTransferDone);
+		else if (!m_transferEvent.wait_until(lock, deadline, isTransferDone))
+		{
+			timedOut = true;
+			continue;
+		}
+
+		succeeded = m_transferSucceeded;
+		error = m_transferError;
+	}
+
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const auto image = succeeded ? sensor->getImage() : nullptr;
+	const auto bytes = image != nullptr ? sizeof(unsigned short) * static_cast<double>(image->getBufferLength()) : 0.0;
+
+	m_stats.retries += attempt > 0 ? attempt - 1 : 0;
+	if (timedOut)
+	{
+		++m_stats.timeouts;
+		error = "The download timed out";
+	}
+
+	if (succeeded)
+	{
+		++m_stats.downloads;
+		m_stats.bytes += bytes;
+		m_stats.seconds += seconds;
+		m_stats.lastThroughputMBps = seconds > 0.0 ? bytes / seconds / 1048576.0 : 0.0;
+	}
+
+	m_succeeded = succeeded;
+	m_lastError = error;
+	m_busy = false;
+	m_completeEvent.notify_all();
+
+	//The caller already has the timeout, the transport stays taken until the SDK gives up on the transfer so the other sensor cannot start one over it
+	if (timedOut)
+		m_transferEvent.wait(lock, isTransferDone);
+}
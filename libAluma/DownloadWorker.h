@@ -0,0 +1,77 @@
+#pragma once
+
+#include "PromiseExecutor.h"
+
+#include <dlapi.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+//Runs ISensor::startDownload() on a dedicated thread so the X2 entry points never spin on the promise
+class DownloadWorker
+{
+public:
+	//Network transfers lose datagrams, so they get retries and an overall deadline, USB transfers get neither by default
+	struct Policy
+	{
+		unsigned int attempts{ 1 };
+		//Covers all attempts of one download, zero waits for as long as the SDK keeps the transfer going
+		std::chrono::milliseconds timeout{ 0 };
+	};
+
+	struct Stats
+	{
+		size_t downloads{ 0 };
+		size_t retries{ 0 };
+		size_t timeouts{ 0 };
+		double bytes{ 0.0 };
+		double seconds{ 0.0 };
+		double lastThroughputMBps{ 0.0 };
+	};
+
+	//The camera can only transfer one sensor's image at a time, workers of the same camera share transportMutex
+	DownloadWorker(std::mutex& transportMutex, PromiseExecutor& executor);
+	~DownloadWorker();
+
+	DownloadWorker(DownloadWorker const&) = delete;
+	void operator=(DownloadWorker const&) = delete;
+
+	bool Start(const dl::ISensorPtr& sensor);
+	bool Wait(std::string& error);
+	bool IsBusy() const;
+
+	void SetPolicy(const Policy& policy);
+	Stats GetStats() const;
+	void ResetStats();
+
+private:
+	void Run();
+	//Reports the result itself, before a timed out transfer has settled
+	void Download(const dl::ISensorPtr& sensor, const Policy& policy);
+
+	std::mutex& m_transportMutex;
+	PromiseExecutor& m_executor;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_requestEvent;
+	std::condition_variable m_completeEvent;
+	std::condition_variable m_transferEvent;
+
+	dl::ISensorPtr m_pendingSensor{ nullptr };
+	bool m_busy{ false };
+	bool m_succeeded{ true };
+	bool m_stopping{ false };
+	std::string m_lastError;
+	//Outcome of the startDownload() promise of the current attempt
+	bool m_transferDone{ false };
+	bool m_transferSucceeded{ false };
+	std::string m_transferError;
+	Policy m_policy;
+	Stats m_stats;
+
+	//Declared last, the worker starts in the constructor and uses everything above
+	std::thread m_thread;
+};
@@ -0,0 +1,307 @@
+#include "FilterWheelController.h"
+
+#include <algorithm>
+
+//Share of the predicted move time after which the wheel is asked for its status
+constexpr double PREDICTION_MARGIN = 0.9;
+//Weight of the latest move in the predicted move time
+constexpr double PREDICTION_WEIGHT = 0.3;
+//Status queries are at least this far apart once the move is due
+constexpr auto STATUS_QUERY_INTERVAL = std::chrono::milliseconds(100);
+//An idle status with no busy one before it may predate the move, it is only trusted once the wheel has had this long to start
+constexpr auto UNOBSERVED_MOVE_TIME = std::chrono::milliseconds(500);
+
+
+FilterWheelController::FilterWheelController(PromiseExecutor& executor) :
+	m_executor(executor)
+{
+}
+
+FilterWheelController::~FilterWheelController()
+{
+	Stop();
+}
+
+const char* FilterWheelController::GetStateName(const State& state)
+{
+	switch (state)
+	{
+	case Idle:		return "idle";
+	case Pending:	return "pending";
+	case Moving:	return "moving";
+	case Failed:	return "failed";
+	default:		return "unknown";
+	}
+}
+
+void FilterWheelController::Start(const dl::IFWPtr& filterWheel)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_filterWheel = filterWheel;
+	m_slots = filterWheel->getSlots();
+	m_position = filterWheel->getPosition();
+	m_state = Idle;
+
+	//The learned move times are kept over a reconnect to the same wheel
+	if (m_stats.distances.size() != m_slots)
+		m_stats.distances.assign(m_slots, DistanceStats{});
+}
+
+void FilterWheelController::Stop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	++m_move;
+	m_idleEvent.wait(lock, [this] { return m_inFlight == 0; });
+
+	m_filterWheel = nullptr;
+	m_state = Idle;
+	m_statusQueried = false;
+}
+
+bool FilterWheelController::Move(const int& position, const bool& deferred)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_filterWheel == nullptr)
+		return false;
+
+	++m_move;
+	m_target = position;
+	m_statusQueried = false;
+	m_error.clear();
+
+	if (deferred)
+		m_state = Pending;
+	else
+		StartMove();
+
+	return true;
+}
+
+void FilterWheelController::Release()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_state == Pending)
+		StartMove();
+}
+
+void FilterWheelController::StartMove()
+{
+	//Called with m_mutex held, the move is timed from here
+	const auto move = m_move;
+	const auto position = m_target;
+	const auto slots = static_cast<int>(m_slots);
+
+	m_state = Moving;
+	m_distance = m_position >= 0 && slots > 0 ? ((position - m_position) % slots + slots) % slots : -1;
+	m_started = std::chrono::steady_clock::now();
+	m_commandDone = false;
+	m_wheelBusy = false;
+	m_wheelIdle = false;
+
+	const auto predictedSeconds = m_distance > 0 ? m_stats.distances[m_distance].predictedSeconds : 0.0;
+	m_predictedEnd = m_started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(predictedSeconds * PREDICTION_MARGIN));
+
+	const auto filterWheel = m_filterWheel;
+	Submit(PromiseExecutor::Exposure, [filterWheel, position] { return filterWheel->setPosition(position); },
+		[this, move](const bool& succeeded, const std::string& error)
+		{
+			if (move != m_move)
+				return;
+
+			if (succeeded)
+				m_commandDone = true;
+			else
+			{
+				m_state = Failed;
+				m_error = error;
+			}
+		});
+}
+
+bool FilterWheelController::IsComplete(bool& complete, std::string& error)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	complete = m_state == Idle || m_state == Failed;
+
+	if (m_state == Failed)
+	{
+		error = m_error;
+		m_state = Idle;
+		m_position = -1;
+		return false;
+	}
+
+	if (m_state == Idle || m_state == Pending)
+		return true;
+
+	//A move to the slot the wheel is known to be at ends with the command
+	if (m_wheelIdle || (m_commandDone && m_distance == 0))
+	{
+		Complete();
+		complete = true;
+		return true;
+	}
+
+	//Nothing to ask until the wheel has taken the command, and then only once the move should be nearly done
+	if (!m_commandDone || m_statusQueried)
+		return true;
+
+	const auto now = std::chrono::steady_clock::now();
+	if (now < m_predictedEnd || now - m_lastQuery < STATUS_QUERY_INTERVAL)
+	{
+		++m_stats.suppressedPolls;
+		return true;
+	}
+
+	m_statusQueried = true;
+	m_lastQuery = now;
+	++m_stats.statusQueries;
+
+	const auto move = m_move;
+	const auto filterWheel = m_filterWheel;
+	Submit(PromiseExecutor::Telemetry, [filterWheel] { return filterWheel->queryStatus(); },
+		[this, move, filterWheel, now](const bool& succeeded, const std::string& error)
+		{
+			if (move != m_move)
+				return;
+
+			m_statusQueried = false;
+
+			if (!succeeded)
+			{
+				m_state = Failed;
+				m_error = error;
+			}
+			else if (filterWheel->getStatus() == dl::IFW::FWError)
+			{
+				m_state = Failed;
+				m_error = "The filter wheel reported an error";
+			}
+			else if (filterWheel->getStatus() == dl::IFW::FWBusy)
+			{
+				m_wheelBusy = true;
+				m_wheelBusyAt = now;
+			}
+			else if (m_wheelBusy || now - m_started >= UNOBSERVED_MOVE_TIME)
+			{
+				m_wheelIdle = true;
+				m_wheelIdleAt = now;
+			}
+		});
+
+	return true;
+}
+
+void FilterWheelController::Abort()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//Nothing was sent for a pending move, the wheel is still where it was
+	if (m_state == Pending)
+	{
+		++m_move;
+		++m_stats.aborts;
+		m_state = Idle;
+		return;
+	}
+
+	if (m_state != Moving)
+		return;
+
+	//Callbacks of the abandoned move are ignored, where the wheel stops is unknown
+	++m_move;
+	++m_stats.aborts;
+	m_state = Idle;
+	m_position = -1;
+	m_statusQueried = false;
+}
+
+FilterWheelController::State FilterWheelController::GetState() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_state;
+}
+
+int FilterWheelController::GetPosition() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_state == Idle ? m_position : -1;
+}
+
+FilterWheelController::Stats FilterWheelController::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void FilterWheelController::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_stats.statusQueries = 0;
+	m_stats.suppressedPolls = 0;
+	m_stats.aborts = 0;
+	for (auto& distance : m_stats.distances)
+	{
+		DistanceStats reset;
+		reset.predictedSeconds = distance.predictedSeconds;
+		distance = reset;
+	}
+}
+
+void FilterWheelController::Submit(const PromiseExecutor::Priority& priority, const PromiseExecutor::Issue& issue, const PromiseExecutor::Callback& onComplete)
+{
+	//Called with m_mutex held, the callback runs on the executor's worker and takes it again
+	++m_inFlight;
+	m_executor.Submit(priority, issue, [this, onComplete](const bool& succeeded, const std::string& error)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			onComplete(succeeded, error);
+
+			--m_inFlight;
+			m_idleEvent.notify_all();
+		});
+}
+
+void FilterWheelController::Complete()
+{
+	m_position = m_target;
+	m_state = Idle;
+
+	if (m_distance <= 0 || static_cast<size_t>(m_distance) >= m_stats.distances.size() || !m_wheelIdle)
+		return;
+
+	auto& distance = m_stats.distances[m_distance];
+
+	//Without a busy status the end is not bounded, the move was shorter than the first query and only that query is brought forward
+	if (!m_wheelBusy)
+	{
+		const auto idleSeconds = std::chrono::duration<double>(m_wheelIdleAt - m_started).count();
+		if (distance.predictedSeconds > 0.0)
+			distance.predictedSeconds = std::min(distance.predictedSeconds, idleSeconds) * PREDICTION_MARGIN;
+		return;
+	}
+
+	//The move ended between the last busy status and the first idle one
+	//The prediction follows the last busy status, so the first query of the next move still finds the wheel busy and bounds its end again
+	const auto finished = m_wheelBusyAt + (m_wheelIdleAt - m_wheelBusyAt) / 2;
+	const auto seconds = std::chrono::duration<double>(finished - m_started).count();
+	const auto busySeconds = std::chrono::duration<double>(m_wheelBusyAt - m_started).count();
+
+	++distance.moves;
+	distance.averageSeconds += (seconds - distance.averageSeconds) / static_cast<double>(distance.moves);
+	distance.minSeconds = distance.moves == 1 ? seconds : std::min(distance.minSeconds, seconds);
+	distance.maxSeconds = std::max(distance.maxSeconds, seconds);
+	distance.predictedSeconds = distance.predictedSeconds == 0.0 ? busySeconds
+		: distance.predictedSeconds + PREDICTION_WEIGHT * (busySeconds - distance.predictedSeconds);
+
+	const auto bucket = std::min(static_cast<size_t>(seconds / HISTOGRAM_BUCKET_SECONDS), HISTOGRAM_BUCKETS - 1);
+	++distance.histogram[bucket];
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "PromiseExecutor.h"
+
+#include <dlapi.h>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+//Tracks filter wheel moves on the executor so X2 calls never block on the wheel
+//Learns how long a move over each slot distance takes, and only asks the wheel for its status once a move is predicted to be nearly done
+class FilterWheelController
+{
+public:
+	enum State
+	{
+		Idle,
+		//Held back until the shutter has closed, see Release()
+		Pending,
+		Moving,
+		Failed
+	};
+
+	static constexpr size_t HISTOGRAM_BUCKETS = 32;
+	static constexpr double HISTOGRAM_BUCKET_SECONDS = 0.25;
+
+	//Moves over one slot distance, the last bucket also counts anything slower
+	struct DistanceStats
+	{
+		size_t moves{ 0 };
+		double averageSeconds{ 0.0 };
+		double minSeconds{ 0.0 };
+		double maxSeconds{ 0.0 };
+		//Time into the move the wheel is predicted to still be busy, the next move over this distance is first asked about then, zero until one was measured
+		double predictedSeconds{ 0.0 };
+		std::array<size_t, HISTOGRAM_BUCKETS> histogram{};
+	};
+
+	struct Stats
+	{
+		size_t statusQueries{ 0 };
+		//Polls answered from the model without asking the wheel
+		size_t suppressedPolls{ 0 };
+		size_t aborts{ 0 };
+		//Indexed by the slot distance in the direction of travel
+		std::vector<DistanceStats> distances;
+	};
+
+	explicit FilterWheelController(PromiseExecutor& executor);
+	~FilterWheelController();
+
+	FilterWheelController(FilterWheelController const&) = delete;
+	void operator=(FilterWheelController const&) = delete;
+
+	static const char* GetStateName(const State& state);
+
+	void Start(const dl::IFWPtr& filterWheel);
+	//Waits for the commands in flight, the filter wheel must not be used once Stop returns
+	void Stop();
+
+	//A deferred move is only sent by Release(), for a move requested while the shutter may still be open
+	//Refused when the camera has no filter wheel
+	bool Move(const int& position, const bool& deferred = false);
+	void Release();
+	//Reports a failed move once and goes back to idle
+	bool IsComplete(bool& complete, std::string& error);
+	//A pending move is dropped before it is sent
+	//IFW only offers initialize, queryStatus and setPosition, so an issued move keeps going but is no longer waited on
+	void Abort();
+
+	State GetState() const;
+	//Slot the wheel is known to be at, -1 while a move has not completed or after an aborted one
+	int GetPosition() const;
+	Stats GetStats() const;
+	//Keeps the learned move times, only the counters and histograms start over
+	void ResetStats();
+
+private:
+	void StartMove();
+	void Submit(const PromiseExecutor::Priority& priority, const PromiseExecutor::Issue& issue, const PromiseExecutor::Callback& onComplete);
+	void Complete();
+
+	PromiseExecutor& m_executor;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_idleEvent;
+
+	dl::IFWPtr m_filterWheel{ nullptr };
+	unsigned int m_slots{ 0 };
+	//Position the wheel is known to be at, -1 after an aborted move
+	int m_position{ -1 };
+
+	State m_state{ Idle };
+	//Bumped by every move and abort, callbacks of an older move are ignored
+	unsigned long long m_move{ 0 };
+	int m_target{ 0 };
+	int m_distance{ -1 };
+	std::chrono::steady_clock::time_point m_started;
+	std::chrono::steady_clock::time_point m_predictedEnd;
+	bool m_commandDone{ false };
+	bool m_statusQueried{ false };
+	//Query times of the last busy and the first idle status, the move ended in between
+	bool m_wheelBusy{ false };
+	std::chrono::steady_clock::time_point m_wheelBusyAt;
+	bool m_wheelIdle{ false };
+	std::chrono::steady_clock::time_point m_wheelIdleAt;
+	std::chrono::steady_clock::time_point m_lastQuery;
+	std::string m_error;
+	size_t m_inFlight{ 0 };
+
+	Stats m_stats;
+};
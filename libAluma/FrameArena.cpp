@@ -0,0 +1,200 @@
+#include "FrameArena.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+
+constexpr size_t FRAME_BUFFER_ALIGNMENT = 4096;
+
+
+namespace
+{
+#ifdef _WIN32
+	bool EnableLockMemoryPrivilege()
+	{
+		HANDLE token = nullptr;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+			return false;
+
+		TOKEN_PRIVILEGES privileges{};
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+		//AdjustTokenPrivileges succeeds without granting anything when the account lacks the privilege
+		const auto result = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+			&& AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+			&& GetLastError() == ERROR_SUCCESS;
+
+		CloseHandle(token);
+		return result;
+	}
+
+	unsigned char* AllocateRegion(size_t& bytes, bool& largePages)
+	{
+		if (largePages)
+		{
+			const auto largePageSize = GetLargePageMinimum();
+			if (largePageSize > 0 && EnableLockMemoryPrivilege())
+			{
+				const auto largeBytes = (bytes + largePageSize - 1) / largePageSize * largePageSize;
+				const auto region = VirtualAlloc(nullptr, largeBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+				if (region != nullptr)
+				{
+					bytes = largeBytes;
+					return static_cast<unsigned char*>(region);
+				}
+			}
+			largePages = false;
+		}
+
+		return static_cast<unsigned char*>(VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+	}
+
+	void ReleaseRegion(unsigned char* region, const size_t& bytes)
+	{
+		VirtualFree(region, 0, MEM_RELEASE);
+	}
+#else
+	unsigned char* AllocateRegion(size_t& bytes, bool& largePages)
+	{
+		const auto region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (region == MAP_FAILED)
+			return nullptr;
+
+#ifdef MADV_HUGEPAGE
+		if (largePages)
+			largePages = madvise(region, bytes, MADV_HUGEPAGE) == 0;
+#else
+		largePages = false;
+#endif
+
+		return static_cast<unsigned char*>(region);
+	}
+
+	void ReleaseRegion(unsigned char* region, const size_t& bytes)
+	{
+		munmap(region, bytes);
+	}
+#endif
+}
+
+
+FrameArena::~FrameArena()
+{
+	FreeRegion();
+}
+
+bool FrameArena::Reserve(const size_t& bufferCount, const size_t& bufferPixels, const bool& useLargePages)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_stats.inUse > 0)
+		return false;
+
+	//Keep the current region when it already has the requested shape
+	if (m_region != nullptr && m_stats.bufferCount == bufferCount && m_stats.bufferPixels == bufferPixels && m_requestedLargePages == useLargePages)
+		return true;
+
+	FreeRegion();
+
+	if (bufferCount == 0 || bufferPixels == 0)
+		return false;
+
+	const auto bufferBytes = sizeof(unsigned short) * bufferPixels;
+	const auto bufferStride = (bufferBytes + FRAME_BUFFER_ALIGNMENT - 1) / FRAME_BUFFER_ALIGNMENT * FRAME_BUFFER_ALIGNMENT;
+
+	auto regionBytes = bufferStride * bufferCount;
+	auto largePages = useLargePages;
+	const auto region = AllocateRegion(regionBytes, largePages);
+	if (region == nullptr)
+		return false;
+
+	m_region = region;
+	m_bufferStride = bufferStride;
+	m_requestedLargePages = useLargePages;
+
+	m_free.clear();
+	m_free.reserve(bufferCount);
+	for (size_t i = bufferCount; i > 0; --i)
+		m_free.push_back(reinterpret_cast<unsigned short*>(m_region + (i - 1) * m_bufferStride));
+
+	m_stats = Stats{};
+	m_stats.bufferCount = bufferCount;
+	m_stats.bufferPixels = bufferPixels;
+	m_stats.regionBytes = regionBytes;
+	m_stats.largePages = largePages;
+
+	return true;
+}
+
+void FrameArena::Release()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_stats.inUse == 0)
+		FreeRegion();
+}
+
+unsigned short* FrameArena::Acquire()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	++m_stats.acquireCount;
+	if (m_free.empty())
+	{
+		++m_stats.exhaustedCount;
+		return nullptr;
+	}
+
+	const auto buffer = m_free.back();
+	m_free.pop_back();
+
+	++m_stats.inUse;
+	m_stats.highWaterMark = std::max(m_stats.highWaterMark, m_stats.inUse);
+
+	return buffer;
+}
+
+void FrameArena::Recycle(unsigned short* buffer)
+{
+	if (buffer == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//Capacity was reserved up front, so returning a buffer never allocates
+	m_free.push_back(buffer);
+	--m_stats.inUse;
+}
+
+size_t FrameArena::GetBufferPixels() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats.bufferPixels;
+}
+
+FrameArena::Stats FrameArena::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void FrameArena::FreeRegion()
+{
+	if (m_region == nullptr)
+		return;
+
+	ReleaseRegion(m_region, m_stats.regionBytes);
+
+	m_region = nullptr;
+	m_bufferStride = 0;
+	m_free.clear();
+	m_stats = Stats{};
+}
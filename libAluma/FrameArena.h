@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+
+//Fixed pool of frame sized buffers carved out of one region that is reserved at link time
+class FrameArena
+{
+public:
+	struct Stats
+	{
+		size_t bufferCount{ 0 };
+		size_t bufferPixels{ 0 };
+		size_t regionBytes{ 0 };
+		size_t inUse{ 0 };
+		size_t highWaterMark{ 0 };
+		size_t acquireCount{ 0 };
+		size_t exhaustedCount{ 0 };
+		bool largePages{ false };
+	};
+
+	//Scoped scratch buffer that goes back to the arena when it leaves scope
+	class Buffer
+	{
+	public:
+		explicit Buffer(FrameArena& arena) : m_arena(arena) {}
+		~Buffer() { m_arena.Recycle(m_pixels); }
+
+		Buffer(Buffer const&) = delete;
+		void operator=(Buffer const&) = delete;
+
+		unsigned short* Acquire()
+		{
+			if (m_pixels == nullptr)
+				m_pixels = m_arena.Acquire();
+			return m_pixels;
+		}
+		unsigned short* Get() const { return m_pixels; }
+
+	private:
+		FrameArena& m_arena;
+		unsigned short* m_pixels{ nullptr };
+	};
+
+	FrameArena() = default;
+	~FrameArena();
+
+	FrameArena(FrameArena const&) = delete;
+	void operator=(FrameArena const&) = delete;
+
+	//Fails while buffers of a previous reservation are still checked out
+	bool Reserve(const size_t& bufferCount, const size_t& bufferPixels, const bool& useLargePages);
+	void Release();
+
+	unsigned short* Acquire();
+	void Recycle(unsigned short* buffer);
+
+	size_t GetBufferPixels() const;
+	Stats GetStats() const;
+
+private:
+	void FreeRegion();
+
+	mutable std::mutex m_mutex;
+	unsigned char* m_region{ nullptr };
+	size_t m_bufferStride{ 0 };
+	bool m_requestedLargePages{ false };
+	std::vector<unsigned short*> m_free;
+	Stats m_stats;
+};
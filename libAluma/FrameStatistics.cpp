@@ -0,0 +1,120 @@
+#include "FrameStatistics.h"
+#include "ImageCopy.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+constexpr size_t HISTOGRAM_SIZE = 65536;
+
+
+namespace
+{
+	//Builds a histogram of [rowBegin, rowEnd), copying each row first when dst is set
+	void HistogramRows(uint32_t* histogram, unsigned short* dst, const size_t& dstStride, const unsigned short* src, const size_t& srcStride,
+		const size_t& width, const size_t& rowBegin, const size_t& rowEnd)
+	{
+		for (auto row = rowBegin; row < rowEnd; ++row)
+		{
+			auto pixels = src + row * srcStride;
+
+			if (dst != nullptr)
+			{
+				const auto target = dst + row * dstStride;
+				ImageCopy::CopyRows(reinterpret_cast<unsigned char*>(target), 0, reinterpret_cast<const unsigned char*>(pixels), 0,
+					sizeof(unsigned short) * width, 1);
+				pixels = target;
+			}
+
+			for (size_t i = 0; i < width; ++i)
+				++histogram[pixels[i]];
+		}
+	}
+
+	FrameStatistics::Result Accumulate(ThreadPool& pool, unsigned short* dst, const size_t& dstStride, const unsigned short* src, const size_t& srcStride,
+		const size_t& width, const size_t& rows, const unsigned short& saturationLevel)
+	{
+		FrameStatistics::Result result;
+		if (width == 0 || rows == 0)
+			return result;
+
+		//Each slice fills a private histogram, which is merged once at the end of the slice
+		std::vector<uint64_t> histogram(HISTOGRAM_SIZE, 0);
+		std::mutex mergeMutex;
+
+		const auto histogramSlice = [&](size_t begin, size_t end)
+		{
+			thread_local std::vector<uint32_t> slice;
+			slice.assign(HISTOGRAM_SIZE, 0);
+
+			HistogramRows(slice.data(), dst, dstStride, src, srcStride, width, begin, end);
+
+			std::lock_guard<std::mutex> lock(mergeMutex);
+			for (size_t value = 0; value < HISTOGRAM_SIZE; ++value)
+				histogram[value] += slice[value];
+		};
+
+		if (!pool.ShouldSplit(sizeof(unsigned short) * width * rows))
+			histogramSlice(0, rows);
+		else
+			pool.ParallelFor(rows, histogramSlice);
+
+		//Everything else is derived from the histogram, so the pixels are only read once
+		result.pixels = width * rows;
+		const auto half = (result.pixels + 1) / 2;
+		auto minimumFound = false;
+		auto medianFound = false;
+		size_t seen = 0;
+		double sum = 0.0;
+		double sumOfSquares = 0.0;
+
+		for (size_t value = 0; value < HISTOGRAM_SIZE; ++value)
+		{
+			const auto count = histogram[value];
+			if (count == 0)
+				continue;
+
+			if (!minimumFound)
+			{
+				result.minimum = static_cast<unsigned short>(value);
+				minimumFound = true;
+			}
+			result.maximum = static_cast<unsigned short>(value);
+
+			seen += count;
+			if (!medianFound && seen >= half)
+			{
+				result.median = static_cast<unsigned short>(value);
+				medianFound = true;
+			}
+
+			if (value >= saturationLevel)
+				result.saturated += count;
+
+			sum += static_cast<double>(count) * value;
+			sumOfSquares += static_cast<double>(count) * value * value;
+		}
+
+		result.mean = sum / result.pixels;
+		result.standardDeviation = std::sqrt(std::max(sumOfSquares / result.pixels - result.mean * result.mean, 0.0));
+		result.valid = true;
+
+		return result;
+	}
+}
+
+
+FrameStatistics::Result FrameStatistics::CopyRows(ThreadPool& pool, unsigned short* dst, const size_t& dstStride, const unsigned short* src,
+	const size_t& srcStride, const size_t& width, const size_t& rows, const unsigned short& saturationLevel)
+{
+	return Accumulate(pool, dst, dstStride, src, srcStride, width, rows, saturationLevel);
+}
+
+FrameStatistics::Result FrameStatistics::Measure(ThreadPool& pool, const unsigned short* pixels, const size_t& stride, const size_t& width,
+	const size_t& rows, const unsigned short& saturationLevel)
+{
+	return Accumulate(pool, nullptr, 0, pixels, stride, width, rows, saturationLevel);
+}
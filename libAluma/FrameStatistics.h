@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+class ThreadPool;
+
+
+//Histogram based statistics of 16 bit frames, either measured on their own or accumulated while a frame is copied
+class FrameStatistics
+{
+public:
+	struct Result
+	{
+		bool valid{ false };
+		size_t pixels{ 0 };
+		unsigned short minimum{ 0 };
+		unsigned short maximum{ 0 };
+		unsigned short median{ 0 };
+		double mean{ 0.0 };
+		double standardDeviation{ 0.0 };
+		size_t saturated{ 0 };
+	};
+
+	FrameStatistics() = delete;
+
+	//Copies each row with the ImageCopy kernel and histograms it while it is still in cache, strides are in pixels
+	static Result CopyRows(ThreadPool& pool, unsigned short* dst, const size_t& dstStride, const unsigned short* src, const size_t& srcStride,
+		const size_t& width, const size_t& rows, const unsigned short& saturationLevel);
+
+	static Result Measure(ThreadPool& pool, const unsigned short* pixels, const size_t& stride, const size_t& width, const size_t& rows,
+		const unsigned short& saturationLevel);
+};
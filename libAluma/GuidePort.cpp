@@ -0,0 +1,198 @@
+#include "GuidePort.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+
+//A synchronous pulse fails when the relays are still busy this long after the requested end
+constexpr auto RELAY_TIMEOUT = std::chrono::seconds(1);
+//Interval of the status queries while waiting for the relays to release
+constexpr auto RELAY_POLL_INTERVAL = std::chrono::milliseconds(10);
+
+
+GuidePort::GuidePort(PromiseExecutor& executor) :
+	m_executor(executor)
+{
+}
+
+GuidePort::~GuidePort()
+{
+	Stop();
+}
+
+void GuidePort::Start(const dl::ICameraPtr& camera)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_camera = camera;
+	m_error.clear();
+}
+
+void GuidePort::Stop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_completeEvent.wait(lock, [this] { return m_inFlight == 0; });
+	m_camera = nullptr;
+}
+
+bool GuidePort::Pulse(const int& xMs, const int& yMs, const bool& synchronous, std::string& error)
+{
+	const auto requested = std::chrono::steady_clock::now();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	const auto camera = m_camera;
+	if (camera == nullptr)
+	{
+		error = "The camera is not connected";
+		return false;
+	}
+
+	//Failures of earlier asynchronous pulses are only counted, a synchronous call reports its own
+	m_error.clear();
+
+	//The plus relays move the mount towards +RA and +Dec, the axes run independently and are fired together
+	unsigned int busyBits = 0;
+	if (xMs != 0)
+	{
+		Submit(camera, xMs > 0 ? dl::East : dl::West, static_cast<unsigned int>(std::abs(xMs)), false, requested);
+		busyBits |= dl::PulseGuideStatus::c_xBusy;
+	}
+	if (yMs != 0)
+	{
+		Submit(camera, yMs > 0 ? dl::North : dl::South, static_cast<unsigned int>(std::abs(yMs)), false, requested);
+		busyBits |= dl::PulseGuideStatus::c_yBusy;
+	}
+
+	if (!synchronous || busyBits == 0)
+		return true;
+
+	if (!WaitForCommands(lock, error))
+		return false;
+
+	lock.unlock();
+
+	//The relays close once the camera has acknowledged the command, the pulse is timed from there
+	const auto expectedEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(std::abs(xMs), std::abs(yMs)));
+	return WaitForRelays(camera, busyBits, expectedEnd, error);
+}
+
+bool GuidePort::Abort(std::string& error)
+{
+	const auto requested = std::chrono::steady_clock::now();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	const auto camera = m_camera;
+	if (camera == nullptr)
+	{
+		error = "The camera is not connected";
+		return false;
+	}
+
+	//Failures of earlier asynchronous pulses are only counted, a synchronous call reports its own
+	m_error.clear();
+
+	++m_stats.aborts;
+	Submit(camera, dl::East, 0, true, requested);
+	Submit(camera, dl::North, 0, true, requested);
+
+	return WaitForCommands(lock, error);
+}
+
+GuidePort::Stats GuidePort::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void GuidePort::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats = Stats{};
+}
+
+void GuidePort::Submit(const dl::ICameraPtr& camera, const dl::EPulseGuideDirection& direction, const unsigned int& durationMs, const bool& abort,
+	const std::chrono::steady_clock::time_point& requested)
+{
+	//Called with m_mutex held, the callback runs on the executor's worker and takes it again
+	if (!abort)
+		++m_stats.pulses;
+
+	++m_inFlight;
+	m_executor.Submit(PromiseExecutor::Guiding, [camera, direction, durationMs, abort] { return camera->pulseGuide(direction, durationMs, abort); },
+		[this, requested, abort](const bool& succeeded, const std::string& error)
+		{
+			const auto latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - requested).count();
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!succeeded)
+			{
+				++m_stats.failures;
+				if (m_error.empty())
+					m_error = error;
+			}
+			else if (!abort)
+				Record(m_stats.commandLatency, latencyMs);
+
+			--m_inFlight;
+			m_completeEvent.notify_all();
+		});
+}
+
+bool GuidePort::WaitForCommands(std::unique_lock<std::mutex>& lock, std::string& error)
+{
+	m_completeEvent.wait(lock, [this] { return m_inFlight == 0; });
+
+	if (m_error.empty())
+		return true;
+
+	error = m_error;
+	m_error.clear();
+	return false;
+}
+
+bool GuidePort::WaitForRelays(const dl::ICameraPtr& camera, const unsigned int& busyBits, const std::chrono::steady_clock::time_point& expectedEnd, std::string& error)
+{
+	//The relays cannot release before the requested duration, so the status is not asked any earlier
+	std::this_thread::sleep_until(expectedEnd);
+
+	const auto deadline = expectedEnd + RELAY_TIMEOUT;
+	while (true)
+	{
+		const auto queried = std::chrono::steady_clock::now();
+		if (!m_executor.Wait(m_executor.Submit(PromiseExecutor::Guiding, [camera] { return camera->queryStatus(); }), error))
+			return false;
+
+		if ((camera->getStatus().pulseGuideStatus & busyBits) == 0)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			Record(m_stats.relayOverrun, std::chrono::duration<double, std::milli>(queried - expectedEnd).count());
+			return true;
+		}
+
+		if (std::chrono::steady_clock::now() >= deadline)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			++m_stats.timeouts;
+			error = "The guide relays did not release in time";
+			return false;
+		}
+
+		std::this_thread::sleep_for(RELAY_POLL_INTERVAL);
+	}
+}
+
+void GuidePort::Record(Histogram& histogram, const double& ms)
+{
+	const auto value = std::max(ms, 0.0);
+
+	++histogram.count;
+	histogram.averageMs += (value - histogram.averageMs) / static_cast<double>(histogram.count);
+	histogram.maxMs = std::max(histogram.maxMs, value);
+
+	const auto bucket = std::min(static_cast<size_t>(value / HISTOGRAM_BUCKET_MS), HISTOGRAM_BUCKETS - 1);
+	++histogram.buckets[bucket];
+}
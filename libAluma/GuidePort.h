@@ -0,0 +1,78 @@
+#pragma once
+
+#include "PromiseExecutor.h"
+
+#include <dlapi.h>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+
+//Fires the camera's guide port relays with ICamera::pulseGuide() in the executor's guiding class
+//Records how long the camera takes to act on a pulse and how far the relays run past the requested duration
+class GuidePort
+{
+public:
+	static constexpr size_t HISTOGRAM_BUCKETS = 32;
+	static constexpr double HISTOGRAM_BUCKET_MS = 2.0;
+
+	//The last bucket also counts anything slower
+	struct Histogram
+	{
+		size_t count{ 0 };
+		double averageMs{ 0.0 };
+		double maxMs{ 0.0 };
+		std::array<size_t, HISTOGRAM_BUCKETS> buckets{};
+	};
+
+	struct Stats
+	{
+		size_t pulses{ 0 };
+		size_t aborts{ 0 };
+		size_t failures{ 0 };
+		size_t timeouts{ 0 };
+		//From the X2 call to the camera acknowledging the pulse command
+		Histogram commandLatency;
+		//From the end of a synchronous pulse, counted from its acknowledgement, to the status reporting the relays released
+		Histogram relayOverrun;
+	};
+
+	explicit GuidePort(PromiseExecutor& executor);
+	~GuidePort();
+
+	GuidePort(GuidePort const&) = delete;
+	void operator=(GuidePort const&) = delete;
+
+	void Start(const dl::ICameraPtr& camera);
+	//Waits for the commands in flight, the camera must not be used once Stop returns
+	void Stop();
+
+	//Durations in milliseconds, positive for the plus relay of an axis and negative for the minus relay, zero leaves the axis alone
+	//A synchronous pulse returns once the status reports both relays released
+	bool Pulse(const int& xMs, const int& yMs, const bool& synchronous, std::string& error);
+	bool Abort(std::string& error);
+
+	Stats GetStats() const;
+	void ResetStats();
+
+private:
+	void Submit(const dl::ICameraPtr& camera, const dl::EPulseGuideDirection& direction, const unsigned int& durationMs, const bool& abort,
+		const std::chrono::steady_clock::time_point& requested);
+	bool WaitForCommands(std::unique_lock<std::mutex>& lock, std::string& error);
+	bool WaitForRelays(const dl::ICameraPtr& camera, const unsigned int& busyBits, const std::chrono::steady_clock::time_point& expectedEnd, std::string& error);
+	static void Record(Histogram& histogram, const double& ms);
+
+	PromiseExecutor& m_executor;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_completeEvent;
+
+	dl::ICameraPtr m_camera{ nullptr };
+	size_t m_inFlight{ 0 };
+	//First failure since the last call, reported when the call is synchronous
+	std::string m_error;
+
+	Stats m_stats;
+};
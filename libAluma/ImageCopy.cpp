@@ -0,0 +1,162 @@
+#include "ImageCopy.h"
+#include "SimdSupport.h"
+#include "ThreadPool.h"
+
+#include <cstring>
+
+
+namespace
+{
+	void CopyRowScalar(unsigned char* dst, const unsigned char* src, const size_t& rowBytes)
+	{
+		memcpy(dst, src, rowBytes);
+	}
+
+#ifdef ALUMA_X86
+	void CopyRowSSE2(unsigned char* dst, const unsigned char* src, const size_t& rowBytes)
+	{
+		size_t i = 0;
+		for (; i + 64 <= rowBytes; i += 64)
+		{
+			const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+			const auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 32));
+			const auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 48));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), a);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 16), b);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 32), c);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 48), d);
+		}
+		for (; i + 16 <= rowBytes; i += 16)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+
+		memcpy(dst + i, src + i, rowBytes - i);
+	}
+
+	ALUMA_TARGET_AVX2 void CopyRowAVX2(unsigned char* dst, const unsigned char* src, const size_t& rowBytes)
+	{
+		size_t i = 0;
+		for (; i + 128 <= rowBytes; i += 128)
+		{
+			const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			const auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+			const auto c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 64));
+			const auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 96));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), a);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), b);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 64), c);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 96), d);
+		}
+		for (; i + 32 <= rowBytes; i += 32)
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+
+		memcpy(dst + i, src + i, rowBytes - i);
+	}
+
+	bool IsAVX2Supported()
+	{
+#ifdef _MSC_VER
+		int info[4] = { 0 };
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		//AVX2 needs both the CPU flag and the OS saving the YMM state
+		__cpuid(info, 1);
+		const auto osxsave = (info[2] & (1 << 27)) != 0;
+		const auto avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+#ifdef ALUMA_NEON
+	void CopyRowNEON(unsigned char* dst, const unsigned char* src, const size_t& rowBytes)
+	{
+		size_t i = 0;
+		for (; i + 64 <= rowBytes; i += 64)
+		{
+			const auto a = vld1q_u8(src + i);
+			const auto b = vld1q_u8(src + i + 16);
+			const auto c = vld1q_u8(src + i + 32);
+			const auto d = vld1q_u8(src + i + 48);
+			vst1q_u8(dst + i, a);
+			vst1q_u8(dst + i + 16, b);
+			vst1q_u8(dst + i + 32, c);
+			vst1q_u8(dst + i + 48, d);
+		}
+		for (; i + 16 <= rowBytes; i += 16)
+			vst1q_u8(dst + i, vld1q_u8(src + i));
+
+		memcpy(dst + i, src + i, rowBytes - i);
+	}
+#endif
+}
+
+
+ImageCopy::Kernel ImageCopy::GetKernel()
+{
+	static const auto kernel = DetectKernel();
+	return kernel;
+}
+
+const char* ImageCopy::GetKernelName(const Kernel& kernel)
+{
+	switch (kernel)
+	{
+	case SSE2:	return "SSE2";
+	case AVX2:	return "AVX2";
+	case NEON:	return "NEON";
+	default:	return "Scalar";
+	}
+}
+
+void ImageCopy::CopyRows(unsigned char* dst, const size_t& dstStride, const unsigned char* src, const size_t& srcStride,
+	const size_t& rowBytes, const size_t& rows)
+{
+	const auto copyRow = ALUMA_SELECT_KERNEL(CopyRow);
+
+	//Contiguous buffers on both sides collapse into a single row
+	if (dstStride == rowBytes && srcStride == rowBytes)
+	{
+		copyRow(dst, src, rowBytes * rows);
+		return;
+	}
+
+	for (size_t row = 0; row < rows; ++row)
+		copyRow(dst + row * dstStride, src + row * srcStride, rowBytes);
+}
+
+unsigned int ImageCopy::CopyRows(ThreadPool& pool, unsigned char* dst, const size_t& dstStride, const unsigned char* src, const size_t& srcStride,
+	const size_t& rowBytes, const size_t& rows)
+{
+	if (!pool.ShouldSplit(rowBytes * rows))
+	{
+		CopyRows(dst, dstStride, src, srcStride, rowBytes, rows);
+		return 1;
+	}
+
+	pool.ParallelFor(rows, [&](size_t begin, size_t end)
+	{
+		CopyRows(dst + begin * dstStride, dstStride, src + begin * srcStride, srcStride, rowBytes, end - begin);
+	});
+
+	return pool.GetThreadCount();
+}
+
+ImageCopy::Kernel ImageCopy::DetectKernel()
+{
+#if defined(ALUMA_X86)
+	return IsAVX2Supported() ? AVX2 : SSE2;
+#elif defined(ALUMA_NEON)
+	return NEON;
+#else
+	return Scalar;
+#endif
+}
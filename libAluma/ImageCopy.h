@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+class ThreadPool;
+
+//Row oriented copy of 16 bit frames between buffers with independent strides
+class ImageCopy
+{
+public:
+	enum Kernel
+	{
+		Scalar,
+		SSE2,
+		AVX2,
+		NEON
+	};
+
+	ImageCopy() = delete;
+
+	static Kernel GetKernel();
+	static const char* GetKernelName(const Kernel& kernel);
+
+	static void CopyRows(unsigned char* dst, const size_t& dstStride, const unsigned char* src, const size_t& srcStride,
+		const size_t& rowBytes, const size_t& rows);
+
+	//Splits large frames into row slices on the pool, smaller ones are copied on the calling thread
+	static unsigned int CopyRows(ThreadPool& pool, unsigned char* dst, const size_t& dstStride, const unsigned char* src, const size_t& srcStride,
+		const size_t& rowBytes, const size_t& rows);
+
+private:
+	static Kernel DetectKernel();
+};
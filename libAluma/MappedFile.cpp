@@ -0,0 +1,127 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <filesystem>
+
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& path, const size_t& size, const bool& create)
+{
+	Close();
+
+	if (size == 0)
+		return false;
+
+	const auto widePath = std::filesystem::u8path(path).wstring();
+	const auto file = CreateFileW(widePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+		create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(file, &fileSize) || (!create && static_cast<size_t>(fileSize.QuadPart) != size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const auto mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<unsigned long long>(size) >> 32), static_cast<DWORD>(size & 0xffffffff), nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const auto data = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, size);
+	if (data == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file = file;
+	m_mapping = mapping;
+	m_data = static_cast<unsigned char*>(data);
+	m_size = size;
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != nullptr)
+		CloseHandle(m_file);
+
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = nullptr;
+	m_size = 0;
+}
+#else
+bool MappedFile::Open(const std::string& path, const size_t& size, const bool& create)
+{
+	Close();
+
+	if (size == 0)
+		return false;
+
+	const auto file = open(path.c_str(), create ? O_RDWR | O_CREAT : O_RDWR, 0644);
+	if (file < 0)
+		return false;
+
+	struct stat fileStat {};
+	if (fstat(file, &fileStat) != 0 || (!create && static_cast<size_t>(fileStat.st_size) != size)
+		|| (create && ftruncate(file, static_cast<off_t>(size)) != 0))
+	{
+		close(file);
+		return false;
+	}
+
+	const auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if (data == MAP_FAILED)
+	{
+		close(file);
+		return false;
+	}
+
+	m_file = file;
+	m_data = static_cast<unsigned char*>(data);
+	m_size = size;
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_data != nullptr)
+		munmap(m_data, m_size);
+	if (m_file >= 0)
+		close(m_file);
+
+	m_data = nullptr;
+	m_file = -1;
+	m_size = 0;
+}
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+//Read/write memory mapping of a whole file, created or resized to the requested size on open
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(MappedFile const&) = delete;
+	void operator=(MappedFile const&) = delete;
+
+	bool Open(const std::string& path, const size_t& size, const bool& create);
+	void Close();
+
+	unsigned char* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	unsigned char* m_data{ nullptr };
+	size_t m_size{ 0 };
+#ifdef _WIN32
+	void* m_file{ nullptr };
+	void* m_mapping{ nullptr };
+#else
+	int m_file{ -1 };
+#endif
+};
@@ -0,0 +1,156 @@
+#include "OverscanCorrection.h"
+#include "SimdSupport.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <vector>
+
+//Added back after subtraction so read noise around the bias level is not clipped at zero
+constexpr unsigned int OVERSCAN_PEDESTAL = 100;
+//Rows on either side pooled into each per-row level
+constexpr size_t OVERSCAN_ROW_WINDOW = 3;
+
+
+namespace
+{
+	//Adds or subtracts offset from every pixel, saturating at 0 and 65535
+	void OffsetRowScalar(unsigned short* dst, const unsigned short* src, const size_t& count, const unsigned short& offset, const bool& subtract)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			dst[i] = subtract
+				? static_cast<unsigned short>(src[i] > offset ? src[i] - offset : 0)
+				: static_cast<unsigned short>(std::min(static_cast<unsigned int>(src[i]) + offset, 65535u));
+		}
+	}
+
+#ifdef ALUMA_X86
+	void OffsetRowSSE2(unsigned short* dst, const unsigned short* src, const size_t& count, const unsigned short& offset, const bool& subtract)
+	{
+		const auto value = _mm_set1_epi16(static_cast<short>(offset));
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), subtract ? _mm_subs_epu16(pixels, value) : _mm_adds_epu16(pixels, value));
+		}
+		OffsetRowScalar(dst + i, src + i, count - i, offset, subtract);
+	}
+
+	ALUMA_TARGET_AVX2 void OffsetRowAVX2(unsigned short* dst, const unsigned short* src, const size_t& count, const unsigned short& offset, const bool& subtract)
+	{
+		const auto value = _mm256_set1_epi16(static_cast<short>(offset));
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			const auto pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), subtract ? _mm256_subs_epu16(pixels, value) : _mm256_adds_epu16(pixels, value));
+		}
+		OffsetRowScalar(dst + i, src + i, count - i, offset, subtract);
+	}
+#endif
+
+#ifdef ALUMA_NEON
+	void OffsetRowNEON(unsigned short* dst, const unsigned short* src, const size_t& count, const unsigned short& offset, const bool& subtract)
+	{
+		const auto value = vdupq_n_u16(offset);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const auto pixels = vld1q_u16(src + i);
+			vst1q_u16(dst + i, subtract ? vqsubq_u16(pixels, value) : vqaddq_u16(pixels, value));
+		}
+		OffsetRowScalar(dst + i, src + i, count - i, offset, subtract);
+	}
+#endif
+
+	//Histogram median of the overscan pixels in [rowBegin, rowEnd)
+	unsigned short FrameLevel(const unsigned short* src, const size_t& srcStride, const size_t& overscanColumns,
+		const size_t& rowBegin, const size_t& rowEnd)
+	{
+		thread_local std::vector<unsigned int> histogram;
+		histogram.assign(65536, 0);
+
+		for (auto row = rowBegin; row < rowEnd; ++row)
+		{
+			const auto overscan = src + row * srcStride;
+			for (size_t i = 0; i < overscanColumns; ++i)
+				++histogram[overscan[i]];
+		}
+
+		const auto half = ((rowEnd - rowBegin) * overscanColumns + 1) / 2;
+		size_t seen = 0;
+		for (size_t value = 0; value < histogram.size(); ++value)
+		{
+			seen += histogram[value];
+			if (seen >= half)
+				return static_cast<unsigned short>(value);
+		}
+
+		return 0;
+	}
+
+	unsigned short RowLevel(const unsigned short* src, const size_t& srcStride, const size_t& overscanColumns,
+		const size_t& row, const size_t& rows)
+	{
+		thread_local std::vector<unsigned short> samples;
+		samples.clear();
+
+		const auto first = row > OVERSCAN_ROW_WINDOW ? row - OVERSCAN_ROW_WINDOW : 0;
+		const auto last = std::min(row + OVERSCAN_ROW_WINDOW + 1, rows);
+		for (auto r = first; r < last; ++r)
+		{
+			const auto overscan = src + r * srcStride;
+			samples.insert(samples.end(), overscan, overscan + overscanColumns);
+		}
+
+		const auto middle = samples.begin() + samples.size() / 2;
+		std::nth_element(samples.begin(), middle, samples.end());
+		return *middle;
+	}
+
+	void CorrectRows(const unsigned short* src, const size_t& srcStride, const size_t& overscanColumns, const size_t& activeWidth,
+		const size_t& rows, const size_t& rowBegin, const size_t& rowEnd, const OverscanCorrection::Mode& mode, const unsigned short& frameLevel,
+		unsigned short* dst, const size_t& dstStride)
+	{
+		const auto offsetRow = ALUMA_SELECT_KERNEL(OffsetRow);
+
+		for (auto row = rowBegin; row < rowEnd; ++row)
+		{
+			const auto level = mode == OverscanCorrection::PerRow ? RowLevel(src, srcStride, overscanColumns, row, rows) : frameLevel;
+			const auto subtract = level >= OVERSCAN_PEDESTAL;
+			const auto offset = static_cast<unsigned short>(subtract ? level - OVERSCAN_PEDESTAL : OVERSCAN_PEDESTAL - level);
+
+			offsetRow(dst + row * dstStride, src + row * srcStride + overscanColumns, activeWidth, offset, subtract);
+		}
+	}
+}
+
+
+void OverscanCorrection::Apply(ThreadPool& pool, const unsigned short* src, const size_t& srcStride, const size_t& overscanColumns,
+	const size_t& activeWidth, const size_t& rows, const Mode& mode, unsigned short* dst, const size_t& dstStride)
+{
+	if (rows == 0 || activeWidth == 0)
+		return;
+
+	//Without overscan pixels only the crop is done
+	if (mode == Off || overscanColumns == 0)
+	{
+		ImageCopy::CopyRows(pool, reinterpret_cast<unsigned char*>(dst), sizeof(unsigned short) * dstStride,
+			reinterpret_cast<const unsigned char*>(src + overscanColumns), sizeof(unsigned short) * srcStride, sizeof(unsigned short) * activeWidth, rows);
+		return;
+	}
+
+	const auto frameLevel = mode == PerFrame ? FrameLevel(src, srcStride, overscanColumns, 0, rows) : static_cast<unsigned short>(0);
+
+	if (!pool.ShouldSplit(sizeof(unsigned short) * activeWidth * rows))
+	{
+		CorrectRows(src, srcStride, overscanColumns, activeWidth, rows, 0, rows, mode, frameLevel, dst, dstStride);
+		return;
+	}
+
+	pool.ParallelFor(rows, [&](size_t begin, size_t end)
+	{
+		CorrectRows(src, srcStride, overscanColumns, activeWidth, rows, begin, end, mode, frameLevel, dst, dstStride);
+	});
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+class ThreadPool;
+
+
+//Bias subtraction from the sensor's leading overscan columns, cropping the overscan out of the result
+class OverscanCorrection
+{
+public:
+	enum Mode
+	{
+		Off,
+		PerFrame,
+		PerRow
+	};
+
+	OverscanCorrection() = delete;
+
+	//src rows hold overscanColumns overscan pixels followed by activeWidth image pixels, strides are in pixels
+	static void Apply(ThreadPool& pool, const unsigned short* src, const size_t& srcStride, const size_t& overscanColumns,
+		const size_t& activeWidth, const size_t& rows, const Mode& mode, unsigned short* dst, const size_t& dstStride);
+};
@@ -0,0 +1,266 @@
+#include "PromiseExecutor.h"
+
+#include <algorithm>
+#include <vector>
+
+//Interval the worker polls outstanding promises at, doubled while nothing changes so long transfers do not keep it busy
+//A new submission wakes it right away, and the interval starts over whenever a command is issued or finishes
+constexpr auto MIN_POLL_INTERVAL = std::chrono::milliseconds(1);
+constexpr auto MAX_POLL_INTERVAL = std::chrono::milliseconds(50);
+//Commands in flight in the SDK at once, one slot is kept free for guiding
+constexpr size_t MAX_IN_FLIGHT = 4;
+constexpr size_t GUIDING_RESERVE = 1;
+
+
+PromiseExecutor::PromiseExecutor() :
+	m_thread(&PromiseExecutor::Run, this)
+{
+}
+
+PromiseExecutor::~PromiseExecutor()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_submitEvent.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+const char* PromiseExecutor::GetPriorityName(const Priority& priority)
+{
+	switch (priority)
+	{
+	case Guiding:	return "guiding";
+	case Exposure:	return "exposure";
+	case Download:	return "download";
+	case Telemetry:	return "telemetry";
+	default:		return "unknown";
+	}
+}
+
+PromiseExecutor::Ticket PromiseExecutor::Submit(const Priority& priority, const Issue& issue, const Callback& onComplete)
+{
+	Pending pending;
+	pending.priority = std::min(priority, Telemetry);
+	pending.issue = issue;
+	pending.onComplete = onComplete;
+	pending.submitted = std::chrono::steady_clock::now();
+
+	Ticket ticket = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!onComplete)
+		{
+			ticket = m_nextTicket++;
+			m_results.emplace(ticket, Result{});
+		}
+
+		pending.ticket = ticket;
+		m_queues[pending.priority].push_back(std::move(pending));
+		++m_pending;
+	}
+	m_submitEvent.notify_one();
+
+	return ticket;
+}
+
+bool PromiseExecutor::Wait(const Ticket& ticket, std::string& error)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_results.count(ticket) == 0)
+	{
+		error = "Unknown promise ticket";
+		return false;
+	}
+
+	//Looked up again after the wait, submissions in between may have rehashed the map
+	m_completeEvent.wait(lock, [this, &ticket] { return m_results[ticket].done; });
+
+	return TakeResult(ticket, error);
+}
+
+void PromiseExecutor::Drain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_completeEvent.wait(lock, [this] { return m_pending == 0; });
+}
+
+PromiseExecutor::Stats PromiseExecutor::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void PromiseExecutor::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats = Stats{};
+}
+
+void PromiseExecutor::Run()
+{
+	std::list<Pending> outstanding;
+	auto pollInterval = MIN_POLL_INTERVAL;
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		const auto isDue = [this, &outstanding]
+		{
+			const auto queued = m_pending - outstanding.size();
+			return m_stopping || (!m_queues[Guiding].empty() && outstanding.size() < MAX_IN_FLIGHT)
+				|| (queued > 0 && outstanding.size() < MAX_IN_FLIGHT - GUIDING_RESERVE);
+		};
+		if (outstanding.empty())
+			m_submitEvent.wait(lock, isDue);
+		else
+			m_submitEvent.wait_for(lock, pollInterval, isDue);
+
+		std::list<Pending> due;
+		const auto stopping = TakeDue(due, outstanding.size());
+		lock.unlock();
+
+		std::vector<std::pair<Pending, Result>> finished;
+
+		//Commands still queued on shutdown are dropped without being issued
+		for (auto& pending : due)
+		{
+			if (!stopping)
+			{
+				pending.issued = std::chrono::steady_clock::now();
+				pending.promise = pending.issue ? pending.issue() : nullptr;
+				pending.issue = nullptr;
+				outstanding.push_back(std::move(pending));
+				continue;
+			}
+
+			Result result;
+			result.done = true;
+			result.error = "The command was dropped on shutdown";
+			pending.issued = std::chrono::steady_clock::now();
+			if (pending.onComplete)
+				pending.onComplete(false, result.error);
+			finished.emplace_back(std::move(pending), std::move(result));
+		}
+
+		const auto inFlight = outstanding.size();
+
+		//Issued promises are waited on during shutdown, which the SDK times out
+		for (auto pending = outstanding.begin(); pending != outstanding.end();)
+		{
+			const auto status = pending->promise == nullptr ? dl::IPromise::InvalidFuture
+				: (stopping ? pending->promise->wait() : pending->promise->getStatus());
+
+			if (!stopping && (status == dl::IPromise::Idle || status == dl::IPromise::Executing))
+			{
+				++pending;
+				continue;
+			}
+
+			Result result;
+			result.done = true;
+			result.succeeded = Finish(pending->promise, status, result.error);
+			if (pending->onComplete)
+				pending->onComplete(result.succeeded, result.error);
+
+			finished.emplace_back(std::move(*pending), std::move(result));
+			pending = outstanding.erase(pending);
+		}
+
+		pollInterval = due.empty() && finished.empty() ? std::min(pollInterval * 2, MAX_POLL_INTERVAL) : MIN_POLL_INTERVAL;
+
+		const auto now = std::chrono::steady_clock::now();
+		lock.lock();
+
+		m_stats.maxInFlight = std::max(m_stats.maxInFlight, inFlight);
+
+		for (auto& entry : finished)
+		{
+			auto& stats = m_stats.classes[entry.first.priority];
+			const auto count = static_cast<double>(stats.completed + stats.failed + 1);
+			const auto queueMs = std::chrono::duration<double, std::milli>(entry.first.issued - entry.first.submitted).count();
+			const auto latencyMs = std::chrono::duration<double, std::milli>(now - entry.first.submitted).count();
+			stats.averageQueueMs += (queueMs - stats.averageQueueMs) / count;
+			stats.maxQueueMs = std::max(stats.maxQueueMs, queueMs);
+			stats.averageLatencyMs += (latencyMs - stats.averageLatencyMs) / count;
+			stats.maxLatencyMs = std::max(stats.maxLatencyMs, latencyMs);
+			++(entry.second.succeeded ? stats.completed : stats.failed);
+
+			if (entry.first.ticket != 0)
+				m_results[entry.first.ticket] = std::move(entry.second);
+			--m_pending;
+		}
+
+		if (!finished.empty())
+			m_completeEvent.notify_all();
+
+		if (stopping && outstanding.empty() && m_pending == 0)
+			return;
+	}
+}
+
+bool PromiseExecutor::TakeDue(std::list<Pending>& due, const size_t& inFlight)
+{
+	//On shutdown everything queued is handed over, to be dropped
+	if (m_stopping)
+	{
+		for (auto& queue : m_queues)
+			due.splice(due.end(), queue);
+		return true;
+	}
+
+	//Lower classes leave the reserved slots free, so a guide pulse is never queued behind a status poll
+	auto slots = inFlight;
+	for (auto priority = 0; priority < PriorityCount; ++priority)
+	{
+		auto& queue = m_queues[priority];
+		const auto limit = priority == Guiding ? MAX_IN_FLIGHT : MAX_IN_FLIGHT - GUIDING_RESERVE;
+
+		while (!queue.empty() && slots < limit)
+		{
+			due.splice(due.end(), queue, queue.begin());
+			++slots;
+		}
+
+		if (!queue.empty())
+			break;
+	}
+
+	return false;
+}
+
+bool PromiseExecutor::TakeResult(const Ticket& ticket, std::string& error)
+{
+	const auto found = m_results.find(ticket);
+	const auto succeeded = found->second.succeeded;
+	error = std::move(found->second.error);
+	m_results.erase(found);
+
+	return succeeded;
+}
+
+bool PromiseExecutor::Finish(const dl::IPromisePtr& promise, const dl::IPromise::Status& status, std::string& error)
+{
+	if (promise == nullptr)
+	{
+		error = "The SDK returned no promise";
+		return false;
+	}
+
+	const auto succeeded = status == dl::IPromise::Complete;
+	if (!succeeded)
+	{
+		char buf[512] = { 0 };
+		size_t lng = 512;
+		promise->getLastError(&(buf[0]), lng);
+		error = std::string(&(buf[0]), lng);
+	}
+	promise->release();
+
+	return succeeded;
+}
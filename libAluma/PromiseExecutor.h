@@ -0,0 +1,111 @@
+#pragma once
+
+#include <dlapi.h>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+
+//Schedules SDK commands by priority and tracks their promises on one worker thread, so several commands can be in flight
+//while the caller carries on and the SDK's command queue is never flooded
+//Every issued promise is released exactly once, by the worker
+class PromiseExecutor
+{
+public:
+	using Ticket = unsigned long long;
+	using Issue = std::function<dl::IPromisePtr()>;
+	using Callback = std::function<void(const bool& succeeded, const std::string& error)>;
+
+	//Highest priority first, a queued command is only issued once nothing of a higher class is waiting
+	enum Priority
+	{
+		Guiding,
+		Exposure,
+		Download,
+		Telemetry,
+		PriorityCount
+	};
+
+	struct ClassStats
+	{
+		size_t completed{ 0 };
+		size_t failed{ 0 };
+		//Time spent queued in the driver before the command was issued
+		double averageQueueMs{ 0.0 };
+		double maxQueueMs{ 0.0 };
+		//Time from submission to completion
+		double averageLatencyMs{ 0.0 };
+		double maxLatencyMs{ 0.0 };
+	};
+
+	struct Stats
+	{
+		size_t maxInFlight{ 0 };
+		std::array<ClassStats, PriorityCount> classes;
+	};
+
+	PromiseExecutor();
+	~PromiseExecutor();
+
+	PromiseExecutor(PromiseExecutor const&) = delete;
+	void operator=(PromiseExecutor const&) = delete;
+
+	static const char* GetPriorityName(const Priority& priority);
+
+	//issue runs on the worker thread once the command is due and returns its promise
+	//Commands submitted with a callback report through it only and return 0, the others are collected with Wait()
+	//Callbacks run on the worker thread and must not wait on the executor
+	Ticket Submit(const Priority& priority, const Issue& issue, const Callback& onComplete = nullptr);
+	bool Wait(const Ticket& ticket, std::string& error);
+
+	//Waits until every submitted command has completed, the camera must not go away before
+	void Drain();
+
+	Stats GetStats() const;
+	void ResetStats();
+
+private:
+	struct Pending
+	{
+		Ticket ticket{ 0 };
+		Priority priority{ Telemetry };
+		Issue issue;
+		dl::IPromisePtr promise{ nullptr };
+		Callback onComplete;
+		std::chrono::steady_clock::time_point submitted;
+		std::chrono::steady_clock::time_point issued;
+	};
+
+	struct Result
+	{
+		bool done{ false };
+		bool succeeded{ false };
+		std::string error;
+	};
+
+	void Run();
+	bool TakeDue(std::list<Pending>& due, const size_t& inFlight);
+	bool TakeResult(const Ticket& ticket, std::string& error);
+	static bool Finish(const dl::IPromisePtr& promise, const dl::IPromise::Status& status, std::string& error);
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_submitEvent;
+	std::condition_variable m_completeEvent;
+
+	std::array<std::list<Pending>, PriorityCount> m_queues;
+	std::unordered_map<Ticket, Result> m_results;
+	size_t m_pending{ 0 };
+	Ticket m_nextTicket{ 1 };
+	bool m_stopping{ false };
+	Stats m_stats;
+
+	//Declared last, the worker starts in the constructor and uses everything above
+	std::thread m_thread;
+};
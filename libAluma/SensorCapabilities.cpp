@@ -0,0 +1,61 @@
+#include "SensorCapabilities.h"
+
+#include <algorithm>
+#include <cmath>
+
+//Bin factors offered beyond what the sensor supports, done in software
+constexpr int SOFTWARE_BINS[] = { 6, 8 };
+
+
+SensorCapabilities SensorCapabilities::Read(const dl::ISensorPtr& sensor)
+{
+	SensorCapabilities capabilities;
+
+	if (sensor == nullptr)
+		return capabilities;
+
+	capabilities.valid = true;
+	capabilities.info = sensor->getInfo();
+	capabilities.calibration = sensor->getCalibration();
+
+	//The SDK returns the readout modes as one '\n' separated list, indexed like TExposureOptions::readoutMode
+	char buf[1024] = { 0 };
+	size_t lng = sizeof(buf) - 1;
+	sensor->getReadoutModes(&(buf[0]), lng);
+	const std::string modes(&(buf[0]));
+
+	size_t start = 0;
+	while (start < modes.size())
+	{
+		auto end = modes.find('\n', start);
+		if (end == std::string::npos)
+			end = modes.size();
+
+		if (end > start)
+			capabilities.readoutModes.push_back(modes.substr(start, end - start));
+
+		start = end + 1;
+	}
+
+	const auto maxHardwareBin = std::max<int>(static_cast<int>(std::min(capabilities.info.maxBinX, capabilities.info.maxBinY)), 1);
+	for (auto bin = 1; bin <= maxHardwareBin; ++bin)
+		capabilities.binList.push_back(bin);
+
+	for (const auto bin : SOFTWARE_BINS)
+	{
+		if (bin > maxHardwareBin)
+			capabilities.binList.push_back(bin);
+	}
+
+	return capabilities;
+}
+
+double SensorCapabilities::QuantizeExposure(const double& seconds) const
+{
+	auto quantized = std::max(seconds, 0.0);
+
+	if (info.exposurePrecision > 0.0f)
+		quantized = std::round(quantized / info.exposurePrecision) * info.exposurePrecision;
+
+	return std::max(quantized, static_cast<double>(info.minExposureDuration));
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <dlapi.h>
+
+#include <string>
+#include <vector>
+
+
+//Sensor properties read once at link, so geometry queries from TheSkyX never reach the SDK
+//Only the overscan setting changes them, the cache is rebuilt whenever it is applied
+struct SensorCapabilities
+{
+	bool valid{ false };
+	dl::ISensor::Info info{};
+	dl::ISensor::Calibration calibration{};
+	std::vector<std::string> readoutModes;
+	//Bin factors offered to TheSkyX, the hardware ones followed by those done in software
+	std::vector<int> binList;
+
+	static SensorCapabilities Read(const dl::ISensorPtr& sensor);
+
+	//Rounds to the exposure precision of the sensor and clamps to its minimum duration
+	double QuantizeExposure(const double& seconds) const;
+};
@@ -0,0 +1,23 @@
+#include "SensorChannel.h"
+
+
+SensorChannel::SensorChannel(const unsigned int& sensorId, const char* name, std::mutex& transportMutex, PromiseExecutor& executor) :
+	sensorId(sensorId),
+	name(name),
+	lock(name),
+	downloadWorker(transportMutex, executor)
+{
+}
+
+const char* SensorChannel::GetStateName(const State& state)
+{
+	switch (state)
+	{
+	case Idle:			return "idle";
+	case Exposing:		return "exposing";
+	case Reading:		return "reading";
+	case Downloading:	return "downloading";
+	case Ready:			return "ready";
+	default:			return "unknown";
+	}
+}
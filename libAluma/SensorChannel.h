@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ContentionLock.h"
+#include "DownloadWorker.h"
+#include "FrameStatistics.h"
+#include "SensorCapabilities.h"
+
+#include <cameradriverinterface.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+class PromiseExecutor;
+
+
+//Exposure state, binning and download path of one sensor, so the main and external sensors run independently
+struct SensorChannel
+{
+	enum State
+	{
+		Idle,
+		Exposing,
+		Reading,
+		Downloading,
+		Ready
+	};
+
+	//Parameters of the last exposure started on the sensor, used to pick its calibration masters
+	struct ExposureContext
+	{
+		enumPictureType type{ PT_LIGHT };
+		unsigned int exposureMs{ 0 };
+		unsigned int readoutMode{ 0 };
+		bool tecEnabled{ false };
+		int setpoint{ 0 };
+		std::chrono::steady_clock::time_point started;
+	};
+
+	//Totals of the frames copied to TheSkyX, logged at disconnect rather than per frame
+	struct ReadoutStats
+	{
+		size_t readouts{ 0 };
+		double seconds{ 0.0 };
+		double maxSeconds{ 0.0 };
+		double bytes{ 0.0 };
+		size_t calibratedFrames{ 0 };
+		size_t correctedDefects{ 0 };
+	};
+
+	SensorChannel(const unsigned int& sensorId, const char* name, std::mutex& transportMutex, PromiseExecutor& executor);
+
+	SensorChannel(SensorChannel const&) = delete;
+	void operator=(SensorChannel const&) = delete;
+
+	static const char* GetStateName(const State& state);
+
+	const unsigned int sensorId;
+	const char* const name;
+
+	//Guards everything below, the download itself runs on the worker without it
+	ContentionLock lock;
+	DownloadWorker downloadWorker;
+
+	SensorCapabilities capabilities;
+	//Only written under the lock, the filter wheel reads it without taking the lock
+	std::atomic<State> state{ Idle };
+	ExposureContext exposure;
+	unsigned char binX{ 1 };
+	unsigned char binY{ 1 };
+	unsigned char softwareBinX{ 1 };
+	unsigned char softwareBinY{ 1 };
+	FrameStatistics::Result statistics;
+	ReadoutStats readoutStats;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+
+//Single writer, many reader snapshot of a trivially copyable value, readers never block the writer
+template <typename T>
+class Seqlock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "Seqlock values are copied word by word");
+
+public:
+	void Store(const T& value)
+	{
+		uint64_t words[WORD_COUNT] = {};
+		std::memcpy(words, &value, sizeof(T));
+
+		//An odd sequence marks a write in progress
+		const auto sequence = m_sequence.load(std::memory_order_relaxed);
+		m_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (size_t i = 0; i < WORD_COUNT; ++i)
+			m_words[i].store(words[i], std::memory_order_relaxed);
+
+		m_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	T Load() const
+	{
+		uint64_t words[WORD_COUNT];
+
+		while (true)
+		{
+			const auto before = m_sequence.load(std::memory_order_acquire);
+			if (before & 1)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			for (size_t i = 0; i < WORD_COUNT; ++i)
+				words[i] = m_words[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (m_sequence.load(std::memory_order_relaxed) == before)
+				break;
+		}
+
+		T value;
+		std::memcpy(&value, words, sizeof(T));
+		return value;
+	}
+
+private:
+	static constexpr size_t WORD_COUNT = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	std::atomic<uint64_t> m_sequence{ 0 };
+	std::atomic<uint64_t> m_words[WORD_COUNT] = {};
+};
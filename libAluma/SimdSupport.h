@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ImageCopy.h"
+
+//Instruction set selection shared by the image processing kernels, the kernel itself is picked at runtime by ImageCopy::GetKernel()
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ALUMA_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ALUMA_TARGET_AVX2
+#else
+#define ALUMA_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__) || defined(__ARM_NEON)
+#define ALUMA_NEON
+#include <arm_neon.h>
+#endif
+
+//Row function name##AVX2, ##SSE2 or ##NEON for the kernel ImageCopy::GetKernel() picked, name##Scalar otherwise
+#if defined(ALUMA_X86)
+#define ALUMA_SELECT_KERNEL(name) (ImageCopy::GetKernel() == ImageCopy::AVX2 ? &name##AVX2 : ImageCopy::GetKernel() == ImageCopy::SSE2 ? &name##SSE2 : &name##Scalar)
+#elif defined(ALUMA_NEON)
+#define ALUMA_SELECT_KERNEL(name) (ImageCopy::GetKernel() == ImageCopy::NEON ? &name##NEON : &name##Scalar)
+#else
+#define ALUMA_SELECT_KERNEL(name) (&name##Scalar)
+#endif
@@ -0,0 +1,123 @@
+#include "SoftwareBinning.h"
+#include "SimdSupport.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <vector>
+
+
+namespace
+{
+	//Widens one source row and adds it into the 32 bit column accumulator
+	void AccumulateRowScalar(unsigned int* acc, const unsigned short* src, const size_t& count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			acc[i] += src[i];
+	}
+
+#ifdef ALUMA_X86
+	void AccumulateRowSSE2(unsigned int* acc, const unsigned short* src, const size_t& count)
+	{
+		const auto zero = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			const auto lo = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i)), _mm_unpacklo_epi16(pixels, zero));
+			const auto hi = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i + 4)), _mm_unpackhi_epi16(pixels, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), lo);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i + 4), hi);
+		}
+		AccumulateRowScalar(acc + i, src + i, count - i);
+	}
+
+	ALUMA_TARGET_AVX2 void AccumulateRowAVX2(unsigned int* acc, const unsigned short* src, const size_t& count)
+	{
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			const auto lo = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+			const auto hi = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i)), lo));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i + 8), _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i + 8)), hi));
+		}
+		AccumulateRowScalar(acc + i, src + i, count - i);
+	}
+#endif
+
+#ifdef ALUMA_NEON
+	void AccumulateRowNEON(unsigned int* acc, const unsigned short* src, const size_t& count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const auto pixels = vld1q_u16(src + i);
+			vst1q_u32(acc + i, vaddw_u16(vld1q_u32(acc + i), vget_low_u16(pixels)));
+			vst1q_u32(acc + i + 4, vaddw_u16(vld1q_u32(acc + i + 4), vget_high_u16(pixels)));
+		}
+		AccumulateRowScalar(acc + i, src + i, count - i);
+	}
+#endif
+
+	void BinRows(const unsigned short* src, const size_t& srcStride, unsigned short* dst, const size_t& dstStride,
+		const size_t& dstWidth, const size_t& rowBegin, const size_t& rowEnd, const unsigned int& binX, const unsigned int& binY,
+		const SoftwareBinning::Mode& mode)
+	{
+		//One accumulator per thread, grown once to the widest row seen
+		thread_local std::vector<unsigned int> accumulator;
+
+		const auto srcWidth = dstWidth * binX;
+		if (accumulator.size() < srcWidth)
+			accumulator.resize(srcWidth);
+
+		const auto accumulateRow = ALUMA_SELECT_KERNEL(AccumulateRow);
+		const auto binPixels = static_cast<unsigned int>(binX * binY);
+		auto acc = accumulator.data();
+
+		for (auto row = rowBegin; row < rowEnd; ++row)
+		{
+			std::fill(acc, acc + srcWidth, 0u);
+			for (unsigned int y = 0; y < binY; ++y)
+				accumulateRow(acc, src + (row * binY + y) * srcStride, srcWidth);
+
+			auto out = dst + row * dstStride;
+			for (size_t x = 0; x < dstWidth; ++x)
+			{
+				const auto column = acc + x * binX;
+				unsigned int sum = 0;
+				for (unsigned int i = 0; i < binX; ++i)
+					sum += column[i];
+
+				out[x] = static_cast<unsigned short>(mode == SoftwareBinning::Average ? (sum + binPixels / 2) / binPixels : std::min(sum, 65535u));
+			}
+		}
+	}
+}
+
+
+void SoftwareBinning::Bin(const unsigned short* src, const size_t& srcStride, unsigned short* dst, const size_t& dstStride,
+	const size_t& dstWidth, const size_t& dstHeight, const unsigned int& binX, const unsigned int& binY, const Mode& mode)
+{
+	if (binX == 0 || binY == 0)
+		return;
+
+	BinRows(src, srcStride, dst, dstStride, dstWidth, 0, dstHeight, binX, binY, mode);
+}
+
+void SoftwareBinning::Bin(ThreadPool& pool, const unsigned short* src, const size_t& srcStride, unsigned short* dst, const size_t& dstStride,
+	const size_t& dstWidth, const size_t& dstHeight, const unsigned int& binX, const unsigned int& binY, const Mode& mode)
+{
+	if (binX == 0 || binY == 0)
+		return;
+
+	if (!pool.ShouldSplit(sizeof(unsigned short) * dstWidth * binX * dstHeight * binY))
+	{
+		BinRows(src, srcStride, dst, dstStride, dstWidth, 0, dstHeight, binX, binY, mode);
+		return;
+	}
+
+	pool.ParallelFor(dstHeight, [&](size_t begin, size_t end)
+	{
+		BinRows(src, srcStride, dst, dstStride, dstWidth, begin, end, binX, binY, mode);
+	});
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+class ThreadPool;
+
+
+//NxM off-chip binning of 16 bit frames, used when a bin factor cannot be done on the sensor
+class SoftwareBinning
+{
+public:
+	enum Mode
+	{
+		Sum,
+		Average
+	};
+
+	SoftwareBinning() = delete;
+
+	//Bins the top-left (dstWidth * binX) x (dstHeight * binY) pixels of src into dst, strides are in pixels
+	static void Bin(const unsigned short* src, const size_t& srcStride, unsigned short* dst, const size_t& dstStride,
+		const size_t& dstWidth, const size_t& dstHeight, const unsigned int& binX, const unsigned int& binY, const Mode& mode);
+
+	static void Bin(ThreadPool& pool, const unsigned short* src, const size_t& srcStride, unsigned short* dst, const size_t& dstStride,
+		const size_t& dstWidth, const size_t& dstHeight, const unsigned int& binX, const unsigned int& binY, const Mode& mode);
+};
@@ -0,0 +1,170 @@
+#include "StatusPoller.h"
+
+#include <algorithm>
+#include <cmath>
+
+//Rate while a sensor is busy, the TEC is settling or the driver has just changed something
+constexpr auto FAST_POLL_INTERVAL = std::chrono::milliseconds(100);
+constexpr auto SLOW_POLL_INTERVAL = std::chrono::milliseconds(1000);
+constexpr auto BOOST_DURATION = std::chrono::seconds(2);
+//The TEC counts as settled once the sensor is within this many degrees of the setpoint
+constexpr float TEC_SETTLED_DELTA = 0.5f;
+
+
+StatusPoller::StatusPoller(PromiseExecutor& executor) :
+	m_executor(executor),
+	m_thread(&StatusPoller::Run, this)
+{
+}
+
+StatusPoller::~StatusPoller()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_event.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void StatusPoller::Start(const dl::ICameraPtr& camera)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_camera = camera;
+		m_refresh = true;
+		m_boostUntil = std::chrono::steady_clock::now() + BOOST_DURATION;
+		m_lastError.clear();
+		m_stats = Stats{};
+	}
+	m_event.notify_all();
+}
+
+void StatusPoller::Stop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	//Wait for a poll in flight, the camera must not be used once Stop returns
+	m_camera = nullptr;
+	m_event.notify_all();
+	m_event.wait(lock, [this] { return !m_polling; });
+
+	m_snapshot.Store(Snapshot{});
+}
+
+void StatusPoller::Boost()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_refresh = true;
+		m_boostUntil = std::chrono::steady_clock::now() + BOOST_DURATION;
+	}
+	m_event.notify_all();
+}
+
+std::string StatusPoller::GetLastError() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_lastError;
+}
+
+StatusPoller::Stats StatusPoller::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void StatusPoller::Run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	auto interval = SLOW_POLL_INTERVAL;
+
+	while (true)
+	{
+		m_event.wait_for(lock, interval, [this] { return m_stopping || (m_camera != nullptr && m_refresh); });
+
+		if (m_stopping)
+			return;
+
+		if (m_camera == nullptr)
+		{
+			interval = SLOW_POLL_INTERVAL;
+			continue;
+		}
+
+		const auto camera = m_camera;
+		m_refresh = false;
+		m_polling = true;
+		lock.unlock();
+
+		const auto started = std::chrono::steady_clock::now();
+		Snapshot snapshot;
+		std::string error;
+		const auto succeeded = Poll(camera, snapshot, error);
+		const auto latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+		lock.lock();
+		m_polling = false;
+
+		//A snapshot from a camera that was stopped meanwhile is dropped
+		if (m_camera == camera)
+		{
+			m_snapshot.Store(snapshot);
+			if (!succeeded)
+			{
+				m_lastError = error;
+				++m_stats.failures;
+			}
+		}
+
+		++m_stats.polls;
+		m_stats.averageLatencyMs += (latencyMs - m_stats.averageLatencyMs) / m_stats.polls;
+		m_stats.maxLatencyMs = std::max(m_stats.maxLatencyMs, latencyMs);
+
+		interval = IsActive(snapshot) || std::chrono::steady_clock::now() < m_boostUntil ? FAST_POLL_INTERVAL : SLOW_POLL_INTERVAL;
+		m_event.notify_all();
+	}
+}
+
+bool StatusPoller::Poll(const dl::ICameraPtr& camera, Snapshot& snapshot, std::string& error) const
+{
+	snapshot.queried = std::chrono::steady_clock::now();
+	snapshot.valid = true;
+
+	//Status polls are background telemetry, they never hold up guiding or exposure commands
+	if (!m_executor.Wait(m_executor.Submit(PromiseExecutor::Telemetry, [camera] { return camera->queryStatus(); }), error))
+	{
+		snapshot.failed = true;
+		return false;
+	}
+
+	snapshot.status = camera->getStatus();
+
+	//The TEC state is cached by the SDK, it is copied here so one snapshot is consistent
+	const auto tec = camera->getTEC();
+	if (tec != nullptr)
+	{
+		snapshot.tecEnabled = tec->getEnabled();
+		snapshot.tecSetpoint = tec->getSetpoint();
+	}
+
+	return true;
+}
+
+bool StatusPoller::IsActive(const Snapshot& snapshot)
+{
+	if (!snapshot.valid || snapshot.failed)
+		return false;
+
+	const auto isBusy = [](const dl::ISensor::Status& state)
+	{
+		return state != dl::ISensor::Idle && state != dl::ISensor::InvalidSensorState;
+	};
+
+	return isBusy(snapshot.status.mainSensorState) || isBusy(snapshot.status.extSensorState)
+		|| (snapshot.tecEnabled && std::fabs(snapshot.status.sensorTemperature - snapshot.tecSetpoint) > TEC_SETTLED_DELTA);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "PromiseExecutor.h"
+#include "Seqlock.h"
+
+#include <dlapi.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+//Refreshes ICamera::Status and the TEC readings on a background thread, so X2 status calls are served from memory
+class StatusPoller
+{
+public:
+	struct Snapshot
+	{
+		bool valid{ false };
+		bool failed{ false };
+		//Time the status query was issued, anything the camera did before it is reflected
+		std::chrono::steady_clock::time_point queried;
+		dl::ICamera::Status status;
+		bool tecEnabled{ false };
+		float tecSetpoint{ 0.0f };
+	};
+
+	struct Stats
+	{
+		size_t polls{ 0 };
+		size_t failures{ 0 };
+		double averageLatencyMs{ 0.0 };
+		double maxLatencyMs{ 0.0 };
+	};
+
+	explicit StatusPoller(PromiseExecutor& executor);
+	~StatusPoller();
+
+	StatusPoller(StatusPoller const&) = delete;
+	void operator=(StatusPoller const&) = delete;
+
+	void Start(const dl::ICameraPtr& camera);
+	void Stop();
+
+	//Polls right away and keeps the fast rate for a while, for changes the driver has just asked the camera for
+	void Boost();
+
+	Snapshot Read() const { return m_snapshot.Load(); }
+	std::string GetLastError() const;
+	Stats GetStats() const;
+
+private:
+	void Run();
+	bool Poll(const dl::ICameraPtr& camera, Snapshot& snapshot, std::string& error) const;
+	static bool IsActive(const Snapshot& snapshot);
+
+	PromiseExecutor& m_executor;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_event;
+
+	dl::ICameraPtr m_camera{ nullptr };
+	bool m_refresh{ false };
+	bool m_polling{ false };
+	bool m_stopping{ false };
+	std::chrono::steady_clock::time_point m_boostUntil;
+	std::string m_lastError;
+	Stats m_stats;
+
+	Seqlock<Snapshot> m_snapshot;
+
+	//Declared last, the worker starts in the constructor and uses everything above
+	std::thread m_thread;
+};
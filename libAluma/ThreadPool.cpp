@@ -0,0 +1,107 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+constexpr unsigned int MAX_WORKER_COUNT = 7;
+
+
+ThreadPool::ThreadPool(const unsigned int& workerCount)
+{
+	m_threads.reserve(workerCount);
+	for (unsigned int i = 0; i < workerCount; ++i)
+		m_threads.emplace_back(&ThreadPool::Run, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_workEvent.notify_all();
+
+	for (auto& thread : m_threads)
+		thread.join();
+}
+
+unsigned int ThreadPool::GetDefaultWorkerCount()
+{
+	//The calling thread always takes a slice, so leave one core for it
+	const auto cores = std::thread::hardware_concurrency();
+	return cores > 1 ? std::min(cores - 1, MAX_WORKER_COUNT) : 0;
+}
+
+void ThreadPool::ParallelFor(const size_t& count, const std::function<void(size_t, size_t)>& task)
+{
+	if (count == 0)
+		return;
+
+	if (m_threads.empty() || count == 1)
+	{
+		task(0, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> dispatchLock(m_dispatchMutex);
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_doneEvent.wait(lock, [this] { return m_activeWorkers == 0; });
+
+		m_task = &task;
+		m_count = count;
+		m_sliceCount = std::min<size_t>(count, GetThreadCount());
+		m_pendingSlices = m_sliceCount;
+		m_nextSlice = 0;
+		++m_generation;
+	}
+	m_workEvent.notify_all();
+
+	RunSlices();
+
+	//Wait for the slices and for every woken worker to leave RunSlices before task goes out of scope
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneEvent.wait(lock, [this] { return m_pendingSlices == 0 && m_activeWorkers == 0; });
+	m_task = nullptr;
+}
+
+void ThreadPool::Run()
+{
+	auto generation = 0u;
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_workEvent.wait(lock, [this, &generation] { return m_stopping || m_generation != generation; });
+
+		if (m_stopping)
+			return;
+
+		generation = m_generation;
+		++m_activeWorkers;
+		lock.unlock();
+
+		RunSlices();
+
+		lock.lock();
+		--m_activeWorkers;
+		m_doneEvent.notify_all();
+	}
+}
+
+void ThreadPool::RunSlices()
+{
+	size_t slice;
+	while ((slice = m_nextSlice++) < m_sliceCount)
+	{
+		const auto begin = m_count * slice / m_sliceCount;
+		const auto end = m_count * (slice + 1) / m_sliceCount;
+		(*m_task)(begin, end);
+
+		if (--m_pendingSlices == 0)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_doneEvent.notify_all();
+		}
+	}
+}
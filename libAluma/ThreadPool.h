@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+//Persistent worker threads for splitting per-frame work into row slices
+class ThreadPool
+{
+public:
+	explicit ThreadPool(const unsigned int& workerCount);
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const&) = delete;
+	void operator=(ThreadPool const&) = delete;
+
+	static unsigned int GetDefaultWorkerCount();
+
+	//Number of threads taking part in ParallelFor, including the calling thread
+	unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_threads.size()) + 1; }
+
+	//Frames below PARALLEL_THRESHOLD bytes (e.g. guider frames) never wake the workers
+	bool ShouldSplit(const size_t& bytes) const { return bytes >= PARALLEL_THRESHOLD && GetThreadCount() > 1; }
+
+	//Splits [0, count) into slices and blocks until task has run over all of them
+	void ParallelFor(const size_t& count, const std::function<void(size_t, size_t)>& task);
+
+private:
+	static constexpr size_t PARALLEL_THRESHOLD = 4 * 1024 * 1024;
+
+	void Run();
+	void RunSlices();
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_dispatchMutex;
+	std::mutex m_mutex;
+	std::condition_variable m_workEvent;
+	std::condition_variable m_doneEvent;
+
+	const std::function<void(size_t, size_t)>* m_task{ nullptr };
+	size_t m_count{ 0 };
+	size_t m_sliceCount{ 0 };
+	std::atomic<size_t> m_nextSlice{ 0 };
+	std::atomic<size_t> m_pendingSlices{ 0 };
+	unsigned int m_activeWorkers{ 0 };
+	unsigned int m_generation{ 0 };
+	bool m_stopping{ false };
+};